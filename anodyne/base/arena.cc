@@ -0,0 +1,420 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/arena.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <new>
+#include <sstream>
+
+namespace anodyne {
+namespace {
+/// The next identifier to hand out to a `ShardedArena`. 0 is never used.
+std::atomic<uint64_t> next_sharded_arena_id(1);
+}  // anonymous namespace
+
+void ArenaStats::Merge(const ArenaStats& other) {
+  allocation_count += other.allocation_count;
+  requested_bytes += other.requested_bytes;
+  alignment_bytes += other.alignment_bytes;
+  tail_bytes += other.tail_bytes;
+  cleanup_count += other.cleanup_count;
+  for (size_t i = 0; i < huge_histogram.size(); ++i) {
+    huge_histogram[i] += other.huge_histogram[i];
+  }
+  for (const auto& account : other.accounts) {
+    auto& stats = accounts[account.first];
+    stats.count += account.second.count;
+    stats.bytes += account.second.bytes;
+  }
+}
+
+std::string ArenaStats::ToString() const {
+  std::ostringstream out;
+  out << "allocations: " << allocation_count << "\n"
+      << "requested bytes: " << requested_bytes << "\n"
+      << "alignment bytes: " << alignment_bytes << "\n"
+      << "block tail bytes: " << tail_bytes << "\n"
+      << "cleanups: " << cleanup_count << "\n";
+  for (size_t i = 0; i < huge_histogram.size(); ++i) {
+    if (huge_histogram[i] != 0) {
+      out << "huge allocations of [2^" << i << ", 2^" << i + 1
+          << ") bytes: " << huge_histogram[i] << "\n";
+    }
+  }
+  if (accounts.empty()) {
+    return out.str();
+  }
+  // Accounts may be duplicated across shared objects, so merge by name.
+  std::map<std::string, std::map<std::string, ArenaAccountStats>> groups;
+  for (const auto& account : accounts) {
+    auto& stats = groups[account.first->group][account.first->name];
+    stats.count += account.second.count;
+    stats.bytes += account.second.bytes;
+  }
+  std::vector<std::pair<ArenaAccountStats, std::string>> group_totals;
+  for (const auto& group : groups) {
+    ArenaAccountStats total;
+    for (const auto& account : group.second) {
+      total.count += account.second.count;
+      total.bytes += account.second.bytes;
+    }
+    group_totals.emplace_back(total, group.first);
+  }
+  std::sort(group_totals.begin(), group_totals.end(),
+            [](const std::pair<ArenaAccountStats, std::string>& a,
+               const std::pair<ArenaAccountStats, std::string>& b) {
+              return a.first.bytes > b.first.bytes;
+            });
+  for (const auto& group : group_totals) {
+    out << group.second << ": " << group.first.count << " allocations, "
+        << group.first.bytes << " bytes\n";
+    std::vector<std::pair<std::string, ArenaAccountStats>> members(
+        groups[group.second].begin(), groups[group.second].end());
+    std::sort(members.begin(), members.end(),
+              [](const std::pair<std::string, ArenaAccountStats>& a,
+                 const std::pair<std::string, ArenaAccountStats>& b) {
+                return a.second.bytes > b.second.bytes;
+              });
+    for (const auto& member : members) {
+      out << "  " << member.first << ": " << member.second.count
+          << " allocations, " << member.second.bytes << " bytes\n";
+    }
+  }
+  return out.str();
+}
+
+constexpr size_t Arena::kPointerSize;
+constexpr size_t Arena::kDefaultBlockSize;
+
+Arena::~Arena() {
+  RunCleanups(nullptr);
+  for (auto& b : blocks_) {
+    if (b.pooled) {
+      block_pool_->Release(b.data);
+    } else {
+      delete[] b.data;
+    }
+  }
+  for (auto* b : huge_blocks_) {
+    delete[] b;
+  }
+  if (region_begin_ != 0) {
+    munmap(reinterpret_cast<void*>(region_begin_),
+           region_end_ - region_begin_);
+  }
+}
+
+void Arena::RunCleanups(const Cleanup* until) {
+  while (cleanups_ != until) {
+    Cleanup* node = cleanups_;
+    cleanups_ = node->next;
+    node->cleanup(node->object);
+  }
+}
+
+size_t Arena::PaddedSize(size_t bytes, size_t alignment) {
+  // `new char[]` is good for any fundamental alignment.
+  constexpr size_t kBlockAlignment = alignof(std::max_align_t);
+  return alignment > kBlockAlignment ? bytes + alignment - kBlockAlignment
+                                     : bytes;
+}
+
+void* Arena::NewSlow(size_t bytes, size_t alignment) {
+  if (backend_ == ArenaBackend::kMmap) {
+    return NewFromRegion(bytes, alignment);
+  }
+  size_t padded_bytes = PaddedSize(bytes, alignment);
+  if (padded_bytes > max_block_size_) {
+    char* huge_block = new char[padded_bytes];
+    huge_blocks_.push_back(huge_block);
+    size_t log2 = 0;
+    while ((bytes >> (log2 + 1)) != 0) {
+      ++log2;
+    }
+    ++stats_.huge_histogram[log2];
+    uintptr_t base = reinterpret_cast<uintptr_t>(huge_block);
+    uintptr_t result = (base + alignment - 1) & ~(alignment - 1);
+    used_bytes_ += result - base + bytes;
+    return reinterpret_cast<void*>(result);
+  }
+  if (limit_ > next_) {
+    stats_.tail_bytes += limit_ - next_;
+  }
+  // Skip over any reusable blocks (left behind by `Rewind`) that are too
+  // small for this request.
+  while (next_block_index_ < blocks_.size() &&
+         blocks_[next_block_index_].size < padded_bytes) {
+    ++next_block_index_;
+  }
+  if (next_block_index_ == blocks_.size()) {
+    size_t size = next_block_size_ < padded_bytes ? padded_bytes
+                                                  : next_block_size_;
+    if (block_pool_ != nullptr && size == block_pool_->block_size()) {
+      blocks_.push_back(Block{block_pool_->Allocate(), size, true});
+    } else {
+      blocks_.push_back(Block{new char[size], size, false});
+    }
+    if (next_block_size_ < max_block_size_) {
+      next_block_size_ = next_block_size_ * growth_factor_ > max_block_size_
+                             ? max_block_size_
+                             : next_block_size_ * growth_factor_;
+    }
+  }
+  const Block& block = blocks_[next_block_index_++];
+  uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+  uintptr_t result = (base + alignment - 1) & ~(alignment - 1);
+  used_bytes_ += next_ - run_begin_;
+  run_begin_ = base;
+  next_ = result + bytes;
+  limit_ = base + block.size;
+  return reinterpret_cast<void*>(result);
+}
+
+void* Arena::NewFromRegion(size_t bytes, size_t alignment) {
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  // Commit whole pages at a time.
+  const size_t commit =
+      mmap_commit_bytes_ < page_size
+          ? page_size
+          : (mmap_commit_bytes_ + page_size - 1) & ~(page_size - 1);
+  if (region_begin_ == 0) {
+    // Over-reserve so that the region can start on a commit boundary (which
+    // lets the kernel use huge pages from the very first byte).
+    size_t reserve = (mmap_reserve_bytes_ + commit - 1) / commit * commit;
+    void* mapping = mmap(nullptr, reserve + commit, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(mapping);
+    uintptr_t aligned = (begin + commit - 1) / commit * commit;
+    if (aligned != begin) {
+      munmap(mapping, aligned - begin);
+    }
+    uintptr_t end = aligned + reserve;
+    if (begin + reserve + commit != end) {
+      munmap(reinterpret_cast<void*>(end), begin + reserve + commit - end);
+    }
+    if (huge_pages_) {
+      madvise(reinterpret_cast<void*>(aligned), reserve, MADV_HUGEPAGE);
+    }
+    region_begin_ = aligned;
+    region_end_ = end;
+    region_committed_ = aligned;
+  }
+  if (next_ < region_begin_) {
+    // We were rewound to before our first allocation.
+    used_bytes_ += next_ - run_begin_;
+    next_ = region_begin_;
+    run_begin_ = next_;
+  }
+  uintptr_t result = (next_ + alignment - 1) & ~(alignment - 1);
+  if (result > region_end_ || bytes > region_end_ - result) {
+    throw std::bad_alloc();
+  }
+  if (result + bytes > region_committed_) {
+    uintptr_t committed =
+        (result + bytes - region_begin_ + commit - 1) / commit * commit +
+        region_begin_;
+    if (committed > region_end_) {
+      committed = region_end_;
+    }
+    if (mprotect(reinterpret_cast<void*>(region_committed_),
+                 committed - region_committed_,
+                 PROT_READ | PROT_WRITE) != 0) {
+      throw std::bad_alloc();
+    }
+    region_committed_ = committed;
+  }
+  next_ = result + bytes;
+  limit_ = region_committed_;
+  return reinterpret_cast<void*>(result);
+}
+
+ArenaStats Arena::stats() const {
+  ArenaStats stats = stats_;
+  // Whatever space allocations took up beyond what they asked for went to
+  // rounding and alignment.
+  stats.alignment_bytes =
+      used_bytes_ + (next_ - run_begin_) - stats_.requested_bytes;
+  return stats;
+}
+
+bool Arena::ContiguousExtent(const char** begin, size_t* size) const {
+  if (backend_ != ArenaBackend::kMmap) {
+    return false;
+  }
+  if (region_begin_ == 0 || next_ <= region_begin_) {
+    *begin = nullptr;
+    *size = 0;
+  } else {
+    *begin = reinterpret_cast<const char*>(region_begin_);
+    *size = next_ - region_begin_;
+  }
+  return true;
+}
+
+void Arena::ChargeSlow(const ArenaAccount* account, size_t bytes) {
+  auto& stats = stats_.accounts[account];
+  ++stats.count;
+  stats.bytes += bytes;
+}
+
+ArenaBlockPool::ArenaBlockPool(const Options& options)
+    : block_size_(options.block_size),
+      max_bytes_(options.max_bytes),
+      retain_bytes_(options.retain_bytes) {}
+
+ArenaBlockPool::~ArenaBlockPool() {
+  for (auto* block : free_blocks_) {
+    free(block);
+  }
+}
+
+ArenaBlockPool* ArenaBlockPool::Global() {
+  static ArenaBlockPool* global = new ArenaBlockPool();
+  return global;
+}
+
+char* ArenaBlockPool::Allocate() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_blocks_.empty()) {
+      char* block = free_blocks_.back();
+      free_blocks_.pop_back();
+      if (trimmed_count_ > free_blocks_.size()) {
+        trimmed_count_ = free_blocks_.size();
+      }
+      return block;
+    }
+  }
+  void* block = nullptr;
+  if (posix_memalign(&block, sysconf(_SC_PAGESIZE), block_size_) != 0) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(block);
+}
+
+void ArenaBlockPool::Release(char* block) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if ((free_blocks_.size() + 1) * block_size_ > max_bytes_) {
+    free(block);
+    return;
+  }
+  free_blocks_.push_back(block);
+  TrimLocked(retain_bytes_);
+}
+
+void ArenaBlockPool::Trim(size_t retain_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  TrimLocked(retain_bytes);
+}
+
+void ArenaBlockPool::TrimLocked(size_t retain_bytes) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t trimmable_bytes = block_size_ & ~(page_size - 1);
+  while (trimmed_count_ < free_blocks_.size() &&
+         (free_blocks_.size() - trimmed_count_) * block_size_ > retain_bytes) {
+    if (trimmable_bytes != 0) {
+      madvise(free_blocks_[trimmed_count_], trimmable_bytes, MADV_DONTNEED);
+    }
+    ++trimmed_count_;
+  }
+}
+
+void ArenaBlockPool::SetLimits(size_t max_bytes, size_t retain_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_bytes_ = max_bytes;
+  retain_bytes_ = retain_bytes;
+  size_t keep =
+      block_size_ == 0 ? free_blocks_.size() : max_bytes_ / block_size_;
+  if (keep < free_blocks_.size()) {
+    // Drop the least recently released blocks first.
+    size_t drop = free_blocks_.size() - keep;
+    for (size_t i = 0; i < drop; ++i) {
+      free(free_blocks_[i]);
+    }
+    free_blocks_.erase(free_blocks_.begin(), free_blocks_.begin() + drop);
+    trimmed_count_ = trimmed_count_ > drop ? trimmed_count_ - drop : 0;
+  }
+  TrimLocked(retain_bytes_);
+}
+
+size_t ArenaBlockPool::free_block_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_blocks_.size();
+}
+
+size_t ArenaBlockPool::trimmed_block_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return trimmed_count_;
+}
+
+thread_local ShardedArena::Cache ShardedArena::cache_;
+
+ShardedArena::ShardedArena(const Arena::Options& options)
+    : id_(next_sharded_arena_id++), options_(options) {}
+
+Arena* ShardedArena::ThreadArenaSlow() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& shard = shards_[std::this_thread::get_id()];
+  if (shard == nullptr) {
+    shard.reset(new Arena(options_));
+  }
+  cache_.owner = id_;
+  cache_.arena = shard.get();
+  return shard.get();
+}
+
+size_t ShardedArena::shard_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return shards_.size();
+}
+
+size_t ShardedArena::block_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto& shard : shards_) {
+    count += shard.second->block_count();
+  }
+  return count;
+}
+
+ArenaStats ShardedArena::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ArenaStats stats;
+  for (const auto& shard : shards_) {
+    stats.Merge(shard.second->stats());
+  }
+  return stats;
+}
+
+size_t ShardedArena::huge_block_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto& shard : shards_) {
+    count += shard.second->huge_block_count();
+  }
+  return count;
+}
+
+}  // namespace anodyne
@@ -17,82 +17,499 @@
 #ifndef ANODYNE_BASE_ARENA_H_
 #define ANODYNE_BASE_ARENA_H_
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace anodyne {
 
-/// \brief Performs bump-pointer allocation of pointer-aligned memory.
-/// \warning Since `Arena`-allocated objects never have their destructors
-/// called, any non-POD members they have will in turn never be destroyed.
+class Arena;
+class ArenaBlockPool;
+
+/// \brief Where an `Arena` gets its memory from.
+enum class ArenaBackend {
+  /// Blocks allocated with `new[]` (or taken from an `ArenaBlockPool`).
+  kHeap,
+  /// A single large region of address space reserved with `mmap` and
+  /// committed incrementally as it fills. All allocations (even huge ones)
+  /// are contiguous, which keeps TLB pressure down for large trees.
+  kMmap,
+};
+
+/// \brief Something (like a tt constructor) that `Arena` allocations can be
+/// charged to for accounting purposes.
+///
+/// Accounts are identified by address, so each should be a unique object
+/// with static storage duration.
+struct ArenaAccount {
+  /// The group this account belongs to (like a tt datatype).
+  const char* group;
+  /// The name of this account (like a tt constructor).
+  const char* name;
+};
+
+/// \brief The allocations charged to a single `ArenaAccount`.
+struct ArenaAccountStats {
+  /// The number of allocations charged.
+  size_t count = 0;
+  /// The total size of allocations charged.
+  size_t bytes = 0;
+};
+
+/// \brief Describes how an `Arena` has used its memory.
+///
+/// All counts are cumulative: rewinding an `Arena` doesn't reduce them.
+struct ArenaStats {
+  /// The number of calls to `Arena::New`.
+  size_t allocation_count = 0;
+  /// The total number of bytes passed to `Arena::New`.
+  size_t requested_bytes = 0;
+  /// The number of bytes lost to rounding and alignment.
+  size_t alignment_bytes = 0;
+  /// The number of bytes left unused at the ends of normal blocks when the
+  /// `Arena` moved on to other blocks.
+  size_t tail_bytes = 0;
+  /// The number of cleanups registered with `Arena::RegisterCleanup`
+  /// (including those registered by `Arena::Create`).
+  size_t cleanup_count = 0;
+  /// `huge_histogram[i]` counts huge allocations of `[2^i, 2^(i+1))` bytes.
+  std::array<size_t, 64> huge_histogram{};
+  /// Allocations charged to each account, if the `Arena` tracks accounts.
+  std::unordered_map<const ArenaAccount*, ArenaAccountStats> accounts;
+
+  /// \brief Adds `other`'s counts to these.
+  void Merge(const ArenaStats& other);
+  /// \return a human-readable summary of these stats, with accounts
+  /// grouped and sorted by size.
+  std::string ToString() const;
+};
+
+/// \brief A position in an `Arena` that the `Arena` can later be rewound to.
+class ArenaMark {
+ private:
+  friend class Arena;
+  /// The `Arena::next_block_index_` at the time of marking.
+  size_t next_block_index_;
+  /// The `Arena::next_` at the time of marking.
+  uintptr_t next_;
+  /// The `Arena::limit_` at the time of marking.
+  uintptr_t limit_;
+  /// The size of `Arena::huge_blocks_` at the time of marking.
+  size_t huge_block_count_;
+  /// The `Arena::cleanups_` at the time of marking.
+  const void* cleanups_;
+};
+
+/// \brief Performs bump-pointer allocation of aligned memory.
+/// \warning Objects allocated with `New` (or `new (arena)`) never have
+/// their destructors called, so any non-POD members they have will in turn
+/// never be destroyed. Use `Create` for objects that need their destructors
+/// to run.
 class Arena {
  public:
-  Arena() : next_block_index_(0) {}
+  /// \brief Controls the sizes of the blocks an `Arena` requests.
+  struct Options {
+    /// The size of the first normal block.
+    size_t initial_block_size = kDefaultBlockSize;
+    /// The size past which normal blocks stop growing. Requests that won't
+    /// fit in a block of this size get their own huge block.
+    size_t max_block_size = kDefaultBlockSize;
+    /// Each new normal block is this many times the size of the last one,
+    /// up to `max_block_size`.
+    size_t growth_factor = 1;
+    /// If set, normal blocks of the pool's block size are taken from (and
+    /// returned to) this pool instead of the system.
+    ArenaBlockPool* block_pool = nullptr;
+    /// Where the `Arena` gets its memory from. The block size options and
+    /// `block_pool` apply only to `ArenaBackend::kHeap`.
+    ArenaBackend backend = ArenaBackend::kHeap;
+    /// For `ArenaBackend::kMmap`, the amount of address space to reserve.
+    /// Allocating past this throws `std::bad_alloc`.
+    size_t mmap_reserve_bytes = size_t{16} * 1024 * 1024 * 1024;
+    /// For `ArenaBackend::kMmap`, the granularity at which to commit memory.
+    size_t mmap_commit_bytes = 2 * 1024 * 1024;
+    /// For `ArenaBackend::kMmap`, whether to ask the kernel to back the
+    /// region with transparent huge pages (`MADV_HUGEPAGE`).
+    bool huge_pages = false;
+    /// Whether to record the allocations passed to `Charge` in
+    /// `ArenaStats::accounts`.
+    bool track_accounts = false;
+  };
+
+  Arena() : Arena(Options()) {}
+  explicit Arena(const Options& options)
+      : block_pool_(options.block_pool),
+        backend_(options.backend),
+        mmap_reserve_bytes_(options.mmap_reserve_bytes),
+        mmap_commit_bytes_(options.mmap_commit_bytes),
+        huge_pages_(options.huge_pages),
+        track_accounts_(options.track_accounts),
+        next_block_size_(options.initial_block_size),
+        max_block_size_(options.max_block_size < options.initial_block_size
+                            ? options.initial_block_size
+                            : options.max_block_size),
+        growth_factor_(options.growth_factor == 0 ? 1
+                                                  : options.growth_factor) {}
   Arena(const Arena&) = delete;
   Arena& operator=(const Arena&) = delete;
-  ~Arena() {
-    for (auto& b : blocks_) {
-      delete[] b;
+  ~Arena();
+
+  /// The default alignment for allocations. We support only machines with
+  /// power-of-two address size and alignment requirements.
+  static constexpr size_t kPointerSize = sizeof(void*);
+  /// The default size of normal blocks.
+  static constexpr size_t kDefaultBlockSize = 1024 * 64;
+
+  /// \brief Allocate `bytes` bytes, aligned to `alignment`, allocating
+  /// new blocks from the system if necessary.
+  /// \param alignment a power of two. Alignments larger than a pointer
+  /// (for example, 16, 32 or 64 bytes for vector data) are supported.
+  ///
+  /// `bytes` is rounded up to a multiple of `kPointerSize`, so consecutive
+  /// default-aligned allocations are packed without gaps.
+  void* New(size_t bytes, size_t alignment = kPointerSize) {
+    ++stats_.allocation_count;
+    stats_.requested_bytes += bytes;
+    size_t rounded = (bytes + kPointerSize - 1) & ~(kPointerSize - 1);
+    uintptr_t result = (next_ + alignment - 1) & ~(alignment - 1);
+    if (result + rounded > limit_) {
+      return NewSlow(rounded, alignment);
     }
+    next_ = result + rounded;
+    return reinterpret_cast<void*>(result);
   }
 
-  /// \brief Allocate `bytes` bytes, aligned to `kPointerSize`, allocating
-  /// new blocks from the system if necessary.
-  void* New(size_t bytes) {
-    // Align to kPointerSize bytes.
-    bytes = (bytes + kPointerSize - 1) & kPointerSizeMask;
-    if (bytes > kBlockSize) {
-      char* huge_block = new char[bytes];
-      huge_blocks_.push_back(huge_block);
-      return huge_block;
+  /// \brief Constructs a `T` in the `Arena` from `args`.
+  ///
+  /// If `T` isn't trivially destructible, its destructor is run when the
+  /// `Arena` is destroyed or rewound past the object. Destructors run in the
+  /// reverse of the order in which their objects were created. Trivially
+  /// destructible types cost no more than `new (arena) T`.
+  template <typename T, typename... Args>
+  T* Create(Args&&... args) {
+    void* memory =
+        New(sizeof(T), alignof(T) > kPointerSize ? alignof(T) : kPointerSize);
+    // `ArenaObject`'s placement `operator new` hides the global one.
+    T* object = ::new (memory) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      RegisterCleanup(object, &Destroy<T>);
+    }
+    return object;
+  }
+
+  /// \brief Arranges for `cleanup(object)` to be called when the `Arena` is
+  /// destroyed or rewound to a mark taken before this call.
+  void RegisterCleanup(void* object, void (*cleanup)(void*)) {
+    auto* node = static_cast<Cleanup*>(New(sizeof(Cleanup)));
+    node->cleanup = cleanup;
+    node->object = object;
+    node->next = cleanups_;
+    cleanups_ = node;
+    ++stats_.cleanup_count;
+  }
+
+  /// \brief Records an allocation of `bytes` bytes against `account`, if
+  /// this `Arena` tracks accounts. tt-generated constructors call this.
+  void Charge(const ArenaAccount* account, size_t bytes) {
+    if (track_accounts_) {
+      ChargeSlow(account, bytes);
     }
-    offset_ += bytes;
-    if (offset_ > kBlockSize) {
-      if (next_block_index_ == blocks_.size()) {
-        char* next_block = new char[kBlockSize];
-        blocks_.push_back(next_block);
-        current_block_ = next_block;
-      } else {
-        current_block_ = blocks_[next_block_index_];
-      }
-      ++next_block_index_;
-      offset_ = bytes;
+  }
+
+  /// \return statistics about this `Arena`'s allocations.
+  ArenaStats stats() const;
+
+  /// \return a mark recording the `Arena`'s current position.
+  ArenaMark Mark() const {
+    ArenaMark mark;
+    mark.next_block_index_ = next_block_index_;
+    mark.next_ = next_;
+    mark.limit_ = limit_;
+    mark.huge_block_count_ = huge_blocks_.size();
+    mark.cleanups_ = cleanups_;
+    return mark;
+  }
+
+  /// \brief Releases everything allocated since `mark` was taken.
+  ///
+  /// Cleanups registered since `mark` are run first. Normal blocks are kept
+  /// for later allocations; huge blocks are returned to the system. `mark`
+  /// must have come from this `Arena` and must not be newer than any mark
+  /// that has since been rewound to. Objects allocated after `mark` must no
+  /// longer be referenced.
+  void Rewind(const ArenaMark& mark) {
+    RunCleanups(static_cast<const Cleanup*>(mark.cleanups_));
+    used_bytes_ += next_ - run_begin_;
+    next_block_index_ = mark.next_block_index_;
+    next_ = mark.next_;
+    run_begin_ = next_;
+    limit_ = mark.limit_;
+    for (size_t i = mark.huge_block_count_; i < huge_blocks_.size(); ++i) {
+      delete[] huge_blocks_[i];
     }
-    return current_block_ + offset_ - bytes;
+    huge_blocks_.resize(mark.huge_block_count_);
   }
 
-  /// \return the number of normal blocks in use.
+  /// \return the number of normal blocks in use. This is always 0 for
+  /// `ArenaBackend::kMmap`.
   const size_t block_count() const { return blocks_.size(); }
   /// \return the number of huge blocks in use.
   const size_t huge_block_count() const { return huge_blocks_.size(); }
 
+  /// \brief Finds the memory holding every live allocation, if it is one
+  /// contiguous range. This is only the case for `ArenaBackend::kMmap`.
+  /// \param begin set to the start of the range (or null if it is empty).
+  /// \param size set to the length of the range.
+  /// \return false if allocations may be spread across several blocks.
+  bool ContiguousExtent(const char** begin, size_t* size) const;
+
  private:
   friend class ContextBinding;
-  /// The size of a pointer on this machine. We support only machines with
-  /// power-of-two address size and alignment requirements.
-  const size_t kPointerSize = sizeof(void*);
-  /// `kPointerSize` (a power of two) sign-extended from its first set bit.
-  const size_t kPointerSizeMask = ((~kPointerSize) + 1);
-  /// The size of allocation requests to make from the normal heap.
-  const size_t kBlockSize = 1024 * 64;
-
-  /// The next offset in the current block to allocate. Should always be
-  /// `<= kBlockSize`. If it is `== kBlockSize`, the current block is
-  /// exhausted and the `Arena` moves on to the next block, allocating one
-  /// if necessary.
-  size_t offset_ = kBlockSize;
+  /// \brief A normal block.
+  struct Block {
+    /// The start of the block.
+    char* data;
+    /// The size of the block in bytes.
+    size_t size;
+    /// Whether the block belongs to `block_pool_`.
+    bool pooled;
+  };
+  /// \brief A function to call on an object when the `Arena` goes away.
+  struct Cleanup {
+    void (*cleanup)(void*);
+    void* object;
+    /// The previously registered cleanup.
+    Cleanup* next;
+  };
+  /// \brief Runs the destructor of the `T` at `object`.
+  template <typename T>
+  static void Destroy(void* object) {
+    static_cast<T*>(object)->~T();
+  }
+  /// \brief Runs (and forgets) cleanups registered after `until`.
+  void RunCleanups(const Cleanup* until);
+  /// \brief Handles allocations that don't fit in the current block.
+  void* NewSlow(size_t bytes, size_t alignment);
+  /// \brief Handles allocations that pass `limit_` for
+  /// `ArenaBackend::kMmap`, reserving the region and committing memory as
+  /// necessary.
+  void* NewFromRegion(size_t bytes, size_t alignment);
+  /// \brief Records an allocation against an account.
+  void ChargeSlow(const ArenaAccount* account, size_t bytes);
+  /// \return how many bytes a block needs to be sure to fit `bytes` bytes
+  /// aligned to `alignment`.
+  static size_t PaddedSize(size_t bytes, size_t alignment);
+
+  /// Where to get normal blocks from, or null to use the system.
+  ArenaBlockPool* const block_pool_;
+  /// Where to get memory from.
+  const ArenaBackend backend_;
+  /// The size of the region to reserve for `ArenaBackend::kMmap`.
+  const size_t mmap_reserve_bytes_;
+  /// How much of the region to commit at a time.
+  const size_t mmap_commit_bytes_;
+  /// Whether to ask for huge pages for the region.
+  const bool huge_pages_;
+  /// Whether `Charge` should record anything.
+  const bool track_accounts_;
+  /// Statistics about this `Arena`'s allocations. `alignment_bytes` is
+  /// only filled in by `stats()`, so that `New` needn't keep it up to date.
+  ArenaStats stats_;
+  /// The number of bytes (including padding) taken up by allocations
+  /// before `run_begin_`: in earlier blocks, huge blocks, or space that has
+  /// since been rewound.
+  size_t used_bytes_ = 0;
+  /// Where the allocations since the `Arena` last moved to a new block (or
+  /// was rewound) begin. They take up `next_ - run_begin_` bytes.
+  uintptr_t run_begin_ = 1;
+  /// The start of the reserved region, or 0 if none has been reserved.
+  uintptr_t region_begin_ = 0;
+  /// The end of the reserved region.
+  uintptr_t region_end_ = 0;
+  /// The end of the committed part of the region.
+  uintptr_t region_committed_ = 0;
+  /// The next address in the current block to allocate. This starts out
+  /// past `limit_` so that the first request takes the slow path.
+  uintptr_t next_ = 1;
+  /// The end of the current block. If `next_` can't be advanced without
+  /// passing `limit_`, the `Arena` moves on to the next block, allocating
+  /// one if necessary.
+  uintptr_t limit_ = 0;
   /// The index of the next block to allocate from. Should always be
   /// `<= blocks_.size()`. If it is `== blocks_.size()`, a new block is
   /// allocated before the next `New` request completes.
-  size_t next_block_index_;
-  /// The block from which the `Arena` is currently making allocations. May
-  /// be `nullptr` if no allocations have yet been made.
-  char* current_block_;
+  size_t next_block_index_ = 0;
+  /// The size of the next block to allocate from the system.
+  size_t next_block_size_;
+  /// The largest size `next_block_size_` can grow to.
+  const size_t max_block_size_;
+  /// The factor to multiply `next_block_size_` by after each new block.
+  const size_t growth_factor_;
   /// All blocks that the `Arena` has allocated so far.
-  std::vector<char*> blocks_;
+  std::vector<Block> blocks_;
   /// All huge blocks that the `Arena` has allocated so far.
   std::vector<char*> huge_blocks_;
+  /// The most recently registered cleanup, or null.
+  Cleanup* cleanups_ = nullptr;
+};
+
+/// \brief A thread-safe cache of free `Arena` blocks.
+///
+/// Programs that create and destroy many `Arena`s (for example, one
+/// `Context` per compilation unit) can share a pool to avoid returning
+/// blocks to the system only to request them again.
+class ArenaBlockPool {
+ public:
+  /// \brief Tunes an `ArenaBlockPool`.
+  struct Options {
+    /// The size of the blocks this pool manages. This should be a multiple
+    /// of the page size for `retain_bytes` to have any effect.
+    size_t block_size = Arena::kDefaultBlockSize;
+    /// The most memory the pool will hold in free blocks. Blocks released
+    /// past this limit are returned to the system.
+    size_t max_bytes = 256 * 1024 * 1024;
+    /// The most memory the pool will keep resident in free blocks. The
+    /// pages of the least recently released blocks past this limit are
+    /// given back to the system with `madvise(MADV_DONTNEED)`; the blocks
+    /// themselves stay in the pool.
+    size_t retain_bytes = 64 * 1024 * 1024;
+  };
+
+  ArenaBlockPool() : ArenaBlockPool(Options()) {}
+  explicit ArenaBlockPool(const Options& options);
+  ArenaBlockPool(const ArenaBlockPool&) = delete;
+  ArenaBlockPool& operator=(const ArenaBlockPool&) = delete;
+  ~ArenaBlockPool();
+
+  /// \return a pool that lives as long as the process.
+  static ArenaBlockPool* Global();
+
+  /// \return a page-aligned block of `block_size()` bytes.
+  char* Allocate();
+  /// \brief Returns `block` (which must have come from `Allocate`) to the
+  /// pool.
+  void Release(char* block);
+  /// \brief Gives back the pages of all but `retain_bytes` worth of free
+  /// blocks to the system.
+  void Trim(size_t retain_bytes);
+  /// \brief Changes the pool's limits. Limits are enforced as blocks are
+  /// released.
+  void SetLimits(size_t max_bytes, size_t retain_bytes);
+
+  /// \return the size of blocks in this pool.
+  size_t block_size() const { return block_size_; }
+  /// \return the number of free blocks held by the pool.
+  size_t free_block_count() const;
+  /// \return the number of free blocks whose pages were given back.
+  size_t trimmed_block_count() const;
+
+ private:
+  /// \brief Gives back the pages of free blocks until no more than
+  /// `retain_bytes` remain resident. `mutex_` must be held.
+  void TrimLocked(size_t retain_bytes);
+
+  /// The size of blocks in this pool.
+  const size_t block_size_;
+  /// Guards the members below.
+  mutable std::mutex mutex_;
+  /// The most memory to hold in `free_blocks_`.
+  size_t max_bytes_;
+  /// The most memory to keep resident in `free_blocks_`.
+  size_t retain_bytes_;
+  /// Free blocks, from least to most recently released.
+  std::vector<char*> free_blocks_;
+  /// The first `trimmed_count_` entries of `free_blocks_` have had their
+  /// pages given back.
+  size_t trimmed_count_ = 0;
+};
+
+/// \brief Rewinds an `Arena` to its position at construction time when
+/// destroyed.
+///
+/// This allows speculative work to recycle the `Arena`'s memory:
+///
+///     {
+///       ArenaRewinder rewinder(arena);
+///       ... allocate trees that won't outlive this scope ...
+///     }
+class ArenaRewinder {
+ public:
+  explicit ArenaRewinder(Arena* arena) : arena_(arena), mark_(arena->Mark()) {}
+  ~ArenaRewinder() { arena_->Rewind(mark_); }
+  ArenaRewinder(const ArenaRewinder&) = delete;
+  ArenaRewinder& operator=(const ArenaRewinder&) = delete;
+
+ private:
+  /// The `Arena` to rewind.
+  Arena* arena_;
+  /// Where to rewind `arena_` to.
+  ArenaMark mark_;
+};
+
+/// \brief Gives each thread its own `Arena`.
+///
+/// Threads allocate from their own block chains, so the fast path never takes
+/// a lock. Every per-thread `Arena` lives until the `ShardedArena` itself is
+/// destroyed; objects allocated by one thread may be freely referenced by
+/// objects allocated by another.
+class ShardedArena {
+ public:
+  ShardedArena() : ShardedArena(Arena::Options()) {}
+  /// \param options used to configure each per-thread `Arena`.
+  explicit ShardedArena(const Arena::Options& options);
+  ShardedArena(const ShardedArena&) = delete;
+  ShardedArena& operator=(const ShardedArena&) = delete;
+
+  /// \return the `Arena` owned by the calling thread, creating it if
+  /// necessary.
+  Arena* ThreadArena() {
+    if (cache_.owner == id_) {
+      return cache_.arena;
+    }
+    return ThreadArenaSlow();
+  }
+
+  /// \return the number of per-thread `Arena`s created so far.
+  size_t shard_count() const;
+  /// \return the number of normal blocks in use across all shards.
+  size_t block_count() const;
+  /// \return the number of huge blocks in use across all shards.
+  size_t huge_block_count() const;
+  /// \return the sum of all shards' statistics. Shards must not be
+  /// allocating concurrently.
+  ArenaStats stats() const;
+
+ private:
+  /// The last `ShardedArena` this thread allocated from.
+  struct Cache {
+    /// The `id_` of the cached `ShardedArena`, or 0.
+    uint64_t owner = 0;
+    /// This thread's shard in that `ShardedArena`.
+    Arena* arena = nullptr;
+  };
+  /// \brief Finds or creates the calling thread's shard and caches it.
+  Arena* ThreadArenaSlow();
+
+  /// A process-unique identifier for this `ShardedArena`. Unlike its
+  /// address, it is never reused, so a stale `cache_` can't match it.
+  const uint64_t id_;
+  /// Configures each shard.
+  const Arena::Options options_;
+  /// Guards `shards_`.
+  mutable std::mutex mutex_;
+  /// All shards, keyed by the thread that owns them.
+  std::unordered_map<std::thread::id, std::unique_ptr<Arena>> shards_;
+  static thread_local Cache cache_;
 };
 
 /// \brief An object that can be allocated inside an `Arena`.
@@ -139,6 +556,84 @@ ArenaOption<T> None() {
   return ArenaOption<T>(nullptr);
 }
 
+/// \brief A `const T*` stored as an offset from its own address.
+///
+/// Structures that refer to one another only through `ArenaRef`s can be
+/// moved as a whole (for example, by writing an `ArenaBackend::kMmap`
+/// region to disk and mapping it back at a different address) without
+/// being fixed up. An `ArenaRef` converts to and from `const T*`, so it can
+/// usually stand in for one.
+template <typename T>
+class ArenaRef {
+ public:
+  ArenaRef() {}
+  ArenaRef(const T* content) { set(content); }
+  ArenaRef(const ArenaRef& o) { set(o.get()); }
+  ArenaRef& operator=(const ArenaRef& o) {
+    set(o.get());
+    return *this;
+  }
+  ArenaRef& operator=(const T* content) {
+    set(content);
+    return *this;
+  }
+  const T* get() const {
+    return offset_ == 0 ? nullptr
+                        : reinterpret_cast<const T*>(
+                              reinterpret_cast<intptr_t>(this) + offset_);
+  }
+  operator const T*() const { return get(); }
+  const T* operator->() const { return get(); }
+  const T& operator*() const { return *get(); }
+
+ private:
+  void set(const T* content) {
+    offset_ = content == nullptr ? 0
+                                 : reinterpret_cast<intptr_t>(content) -
+                                       reinterpret_cast<intptr_t>(this);
+  }
+  /// The distance from `this` to the referent, or 0 for null.
+  intptr_t offset_ = 0;
+};
+
+/// \brief An `ArenaSlice` that uses `ArenaRef`s instead of pointers.
+template <typename T>
+class RelocatableArenaSlice {
+ public:
+  RelocatableArenaSlice(size_t length, const ArenaRef<T>* contents)
+      : length_(length), contents_(contents) {}
+  RelocatableArenaSlice() {}
+  /// \brief Copies the references in `slice` into `arena`.
+  static RelocatableArenaSlice Copy(Arena* arena, const ArenaSlice<T>& slice) {
+    auto* contents = static_cast<ArenaRef<T>*>(
+        arena->New(slice.size() * sizeof(ArenaRef<T>)));
+    for (size_t i = 0; i < slice.size(); ++i) {
+      new (&contents[i]) ArenaRef<T>(slice[i]);
+    }
+    return RelocatableArenaSlice(slice.size(), contents);
+  }
+  const T* operator[](size_t index) const { return contents_.get()[index]; }
+  size_t size() const { return length_; }
+
+ private:
+  size_t length_ = 0;
+  ArenaRef<ArenaRef<T>> contents_;
+};
+
+/// \brief An `ArenaOption` that uses an `ArenaRef` instead of a pointer.
+template <typename T>
+class RelocatableArenaOption {
+ public:
+  explicit RelocatableArenaOption(const T* content) : content_(content) {}
+  RelocatableArenaOption(const ArenaOption<T>& option)
+      : content_(option.get()) {}
+  bool is_some() const { return content_.get() != nullptr; }
+  const T* get() const { return content_.get(); }
+
+ private:
+  ArenaRef<T> content_;
+};
+
 }  // namespace anodyne
 
 #endif  // ANODYNE_BASE_ARENA_H_
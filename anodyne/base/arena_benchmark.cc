@@ -0,0 +1,197 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/arena.h"
+
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace anodyne {
+namespace {
+
+/// The number of allocations each benchmark iteration makes; enough to
+/// touch a few thousand 64 KiB blocks.
+constexpr int kAllocations = 1 << 20;
+
+/// \brief Fills a fresh `Arena` with `kAllocations` objects of
+/// `state.range(0)` bytes aligned to `alignment`.
+void FillArena(benchmark::State& state, const Arena::Options& options,
+               size_t alignment) {
+  const size_t bytes = state.range(0);
+  for (auto _ : state) {
+    Arena arena(options);
+    for (int i = 0; i < kAllocations; ++i) {
+      benchmark::DoNotOptimize(arena.New(bytes, alignment));
+    }
+    state.counters["blocks"] = arena.block_count();
+  }
+  state.SetItemsProcessed(state.iterations() * kAllocations);
+}
+
+/// \brief A copy of `Arena`'s allocator as it was before it supported
+/// alignments, block growth, pooling or statistics: fixed 64 KiB blocks
+/// and pointer-aligned allocations.
+class BaselineArena {
+ public:
+  BaselineArena() = default;
+  BaselineArena(const BaselineArena&) = delete;
+  BaselineArena& operator=(const BaselineArena&) = delete;
+  ~BaselineArena() {
+    for (auto& b : blocks_) {
+      delete[] b;
+    }
+    for (auto& b : huge_blocks_) {
+      delete[] b;
+    }
+  }
+
+  void* New(size_t bytes) {
+    bytes = (bytes + kPointerSize - 1) & kPointerSizeMask;
+    if (bytes > kBlockSize) {
+      char* huge_block = new char[bytes];
+      huge_blocks_.push_back(huge_block);
+      return huge_block;
+    }
+    offset_ += bytes;
+    if (offset_ > kBlockSize) {
+      char* next_block = new char[kBlockSize];
+      blocks_.push_back(next_block);
+      current_block_ = next_block;
+      offset_ = bytes;
+    }
+    return current_block_ + offset_ - bytes;
+  }
+
+  size_t block_count() const { return blocks_.size(); }
+
+ private:
+  const size_t kPointerSize = sizeof(void*);
+  const size_t kPointerSizeMask = ((~kPointerSize) + 1);
+  const size_t kBlockSize = 1024 * 64;
+  size_t offset_ = kBlockSize;
+  char* current_block_ = nullptr;
+  std::vector<char*> blocks_;
+  std::vector<char*> huge_blocks_;
+};
+
+/// The baseline allocator, for comparison with `BM_FixedBlocks`.
+void BM_BaselineArena(benchmark::State& state) {
+  const size_t bytes = state.range(0);
+  for (auto _ : state) {
+    BaselineArena arena;
+    for (int i = 0; i < kAllocations; ++i) {
+      benchmark::DoNotOptimize(arena.New(bytes));
+    }
+    state.counters["blocks"] = arena.block_count();
+  }
+  state.SetItemsProcessed(state.iterations() * kAllocations);
+}
+BENCHMARK(BM_BaselineArena)->Arg(16)->Arg(48)->Arg(256);
+
+/// `Arena` with its default options: fixed 64 KiB blocks and pointer
+/// alignment, as `BaselineArena` has.
+void BM_FixedBlocks(benchmark::State& state) {
+  FillArena(state, Arena::Options(), Arena::kPointerSize);
+}
+BENCHMARK(BM_FixedBlocks)->Arg(16)->Arg(48)->Arg(256);
+
+/// Blocks that double in size from 64 KiB up to 4 MiB.
+void BM_GrowingBlocks(benchmark::State& state) {
+  Arena::Options options;
+  options.max_block_size = 4 * 1024 * 1024;
+  options.growth_factor = 2;
+  FillArena(state, options, Arena::kPointerSize);
+}
+BENCHMARK(BM_GrowingBlocks)->Arg(16)->Arg(48)->Arg(256);
+
+/// Fixed 64 KiB blocks with cache-line-aligned allocations.
+void BM_FixedBlocksAligned64(benchmark::State& state) {
+  FillArena(state, Arena::Options(), 64);
+}
+BENCHMARK(BM_FixedBlocksAligned64)->Arg(16)->Arg(48)->Arg(256);
+
+/// \brief An object with nothing to destroy.
+struct Trivial : public ArenaObject {
+  uint64_t data[4];
+};
+
+/// \brief An object that owns heap memory. This isn't an `ArenaObject`, since
+/// it's also allocated on the heap.
+struct NonTrivial {
+  std::string text;
+  std::vector<int> numbers;
+};
+
+/// The number of objects each `Create` benchmark iteration makes.
+constexpr int kObjects = 1 << 16;
+
+/// `Create` on a trivially destructible type (no cleanup is registered).
+void BM_CreateTrivial(benchmark::State& state) {
+  for (auto _ : state) {
+    Arena arena;
+    for (int i = 0; i < kObjects; ++i) {
+      benchmark::DoNotOptimize(arena.Create<Trivial>());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kObjects);
+}
+BENCHMARK(BM_CreateTrivial);
+
+/// `new (arena)` on the same type, for comparison with `BM_CreateTrivial`.
+void BM_PlacementNewTrivial(benchmark::State& state) {
+  for (auto _ : state) {
+    Arena arena;
+    for (int i = 0; i < kObjects; ++i) {
+      benchmark::DoNotOptimize(new (&arena) Trivial());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kObjects);
+}
+BENCHMARK(BM_PlacementNewTrivial);
+
+/// `Create` on a type whose destructor must run, including the time to run
+/// the cleanups when the `Arena` is destroyed.
+void BM_CreateNonTrivial(benchmark::State& state) {
+  for (auto _ : state) {
+    Arena arena;
+    for (int i = 0; i < kObjects; ++i) {
+      benchmark::DoNotOptimize(arena.Create<NonTrivial>());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kObjects);
+}
+BENCHMARK(BM_CreateNonTrivial);
+
+/// The same objects on the general heap, for comparison with
+/// `BM_CreateNonTrivial`.
+void BM_HeapNonTrivial(benchmark::State& state) {
+  for (auto _ : state) {
+    std::vector<std::unique_ptr<NonTrivial>> objects;
+    objects.reserve(kObjects);
+    for (int i = 0; i < kObjects; ++i) {
+      objects.emplace_back(new NonTrivial());
+    }
+    benchmark::DoNotOptimize(objects.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kObjects);
+}
+BENCHMARK(BM_HeapNonTrivial);
+
+}  // anonymous namespace
+}  // namespace anodyne
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANODYNE_BASE_ARENA_CONTAINERS_H_
+#define ANODYNE_BASE_ARENA_CONTAINERS_H_
+
+#include "absl/hash/hash.h"
+#include "anodyne/base/arena.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace anodyne {
+
+/// \brief A growable array whose storage comes from an `Arena`.
+///
+/// Like everything else in an `Arena`, elements are never destroyed, so `T`
+/// must be trivially destructible. Growing the vector copies its elements
+/// to a new buffer twice the size of the old one; the old buffer is
+/// abandoned to the `Arena`. Use `reserve` to avoid this when the final
+/// size is known.
+template <typename T>
+class ArenaVector {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "ArenaVector never runs destructors");
+
+ public:
+  explicit ArenaVector(Arena* arena) : arena_(arena) {}
+  ArenaVector(const ArenaVector&) = delete;
+  ArenaVector& operator=(const ArenaVector&) = delete;
+
+  void push_back(const T& value) { emplace_back(value); }
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      reserve(capacity_ == 0 ? kInitialCapacity : capacity_ * 2);
+    }
+    return *new (&data_[size_++]) T(std::forward<Args>(args)...);
+  }
+  void pop_back() {
+    assert(size_ != 0);
+    --size_;
+  }
+  /// \brief Makes room for at least `capacity` elements.
+  void reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+    T* data = static_cast<T*>(arena_->New(capacity * sizeof(T), alignof(T)));
+    for (size_t i = 0; i < size_; ++i) {
+      new (&data[i]) T(std::move(data_[i]));
+    }
+    data_ = data;
+    capacity_ = capacity;
+  }
+  /// \brief Shrinks or grows the vector to `size` elements, value-initializing
+  /// any new ones.
+  void resize(size_t size) {
+    reserve(size);
+    for (size_t i = size_; i < size; ++i) {
+      new (&data_[i]) T();
+    }
+    size_ = size;
+  }
+  void clear() { size_ = 0; }
+
+  T& operator[](size_t index) { return data_[index]; }
+  const T& operator[](size_t index) const { return data_[index]; }
+  T& back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  /// The capacity of the first buffer.
+  static constexpr size_t kInitialCapacity = 8;
+  /// Where buffers come from.
+  Arena* arena_;
+  /// The current buffer, or null if none has been allocated.
+  T* data_ = nullptr;
+  /// The number of elements in use.
+  size_t size_ = 0;
+  /// The number of elements `data_` has room for.
+  size_t capacity_ = 0;
+};
+
+/// \brief A hash map whose storage comes from an `Arena`.
+///
+/// This is an open-addressing table with linear probing. Each slot has a
+/// one-byte control entry holding 7 bits of its key's hash, so most probes
+/// only touch the densely-packed control bytes. Entries are never destroyed
+/// and can't be erased; `K` and `V` must be trivially destructible. As with
+/// `ArenaVector`, growing the table abandons the old storage to the
+/// `Arena`.
+///
+/// Pointers to values stay valid until the next insertion.
+template <typename K, typename V, typename Hash = absl::Hash<K>,
+          typename Eq = std::equal_to<K>>
+class ArenaHashMap {
+  static_assert(std::is_trivially_destructible<K>::value &&
+                    std::is_trivially_destructible<V>::value,
+                "ArenaHashMap never runs destructors");
+
+ public:
+  /// \brief A key and its value.
+  struct Entry {
+    K key;
+    V value;
+  };
+
+  /// \brief Iterates over the entries in the map in an unspecified order.
+  class const_iterator {
+   public:
+    const Entry& operator*() const { return map_->entries_[index_]; }
+    const Entry* operator->() const { return &map_->entries_[index_]; }
+    const_iterator& operator++() {
+      ++index_;
+      SkipEmpty();
+      return *this;
+    }
+    bool operator==(const const_iterator& o) const {
+      return index_ == o.index_;
+    }
+    bool operator!=(const const_iterator& o) const {
+      return index_ != o.index_;
+    }
+
+   private:
+    friend class ArenaHashMap;
+    const_iterator(const ArenaHashMap* map, size_t index)
+        : map_(map), index_(index) {
+      SkipEmpty();
+    }
+    void SkipEmpty() {
+      while (index_ < map_->capacity_ && map_->control_[index_] == kEmpty) {
+        ++index_;
+      }
+    }
+    const ArenaHashMap* map_;
+    size_t index_;
+  };
+
+  /// \param capacity_hint the number of entries to make room for up front.
+  explicit ArenaHashMap(Arena* arena, size_t capacity_hint = 0)
+      : arena_(arena) {
+    if (capacity_hint != 0) {
+      Rehash(CapacityFor(capacity_hint));
+    }
+  }
+  ArenaHashMap(const ArenaHashMap&) = delete;
+  ArenaHashMap& operator=(const ArenaHashMap&) = delete;
+
+  /// \return the value for `key`, or null if there isn't one.
+  V* Find(const K& key) { return Find(key, HashOf(key)); }
+  const V* Find(const K& key) const { return Find(key, HashOf(key)); }
+  /// \brief Like `Find(key)`, but with `hash == HashOf(key)` precomputed.
+  V* Find(const K& key, size_t hash) {
+    return const_cast<V*>(
+        static_cast<const ArenaHashMap*>(this)->Find(key, hash));
+  }
+  const V* Find(const K& key, size_t hash) const {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    uint8_t tag = TagFor(hash);
+    for (size_t i = hash >> 7;; ++i) {
+      i &= capacity_ - 1;
+      uint8_t control = control_[i];
+      if (control == kEmpty) {
+        return nullptr;
+      }
+      if (control == tag && eq_(entries_[i].key, key)) {
+        return &entries_[i].value;
+      }
+    }
+  }
+  /// \brief Maps `key` to `value` unless `key` already has a value.
+  /// \return the value for `key` and whether it was just inserted.
+  std::pair<V*, bool> Insert(const K& key, const V& value) {
+    return Insert(key, value, HashOf(key));
+  }
+  /// \brief Like `Insert(key, value)`, but with `hash == HashOf(key)`
+  /// precomputed.
+  std::pair<V*, bool> Insert(const K& key, const V& value, size_t hash) {
+    if ((size_ + 1) * 8 > capacity_ * 7) {
+      Rehash(capacity_ == 0 ? kInitialCapacity : capacity_ * 2);
+    }
+    uint8_t tag = TagFor(hash);
+    for (size_t i = hash >> 7;; ++i) {
+      i &= capacity_ - 1;
+      uint8_t control = control_[i];
+      if (control == kEmpty) {
+        control_[i] = tag;
+        new (&entries_[i]) Entry{key, value};
+        ++size_;
+        return std::make_pair(&entries_[i].value, true);
+      }
+      if (control == tag && eq_(entries_[i].key, key)) {
+        return std::make_pair(&entries_[i].value, false);
+      }
+    }
+  }
+  /// \return the hash of `key` used to place it in the table.
+  size_t HashOf(const K& key) const { return hash_(key); }
+  /// \brief Starts loading the memory that a lookup of a key with hash `hash`
+  /// will touch first. Use this to overlap the cache misses of a batch of
+  /// lookups.
+  void Prefetch(size_t hash) const {
+    if (capacity_ != 0) {
+      size_t i = (hash >> 7) & (capacity_ - 1);
+      __builtin_prefetch(&control_[i]);
+      __builtin_prefetch(&entries_[i]);
+    }
+  }
+  /// \return the value for `key`, inserting a value-initialized one if
+  /// necessary.
+  V& operator[](const K& key) { return *Insert(key, V()).first; }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  /// \return the number of slots in the table.
+  size_t capacity() const { return capacity_; }
+
+ private:
+  /// Marks an unused slot. Used slots always have their high bit set.
+  static constexpr uint8_t kEmpty = 0;
+  /// The number of slots in the first table.
+  static constexpr size_t kInitialCapacity = 16;
+
+  /// \return the control byte for a key with hash `hash`.
+  static uint8_t TagFor(size_t hash) { return 0x80 | (hash & 0x7f); }
+  /// \return the smallest capacity that holds `size` entries.
+  static size_t CapacityFor(size_t size) {
+    size_t capacity = kInitialCapacity;
+    while (size * 8 > capacity * 7) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+  /// \brief Moves every entry to a fresh table with `capacity` slots.
+  void Rehash(size_t capacity) {
+    uint8_t* old_control = control_;
+    Entry* old_entries = entries_;
+    size_t old_capacity = capacity_;
+    control_ = static_cast<uint8_t*>(arena_->New(capacity));
+    memset(control_, kEmpty, capacity);
+    entries_ = static_cast<Entry*>(
+        arena_->New(capacity * sizeof(Entry), alignof(Entry)));
+    capacity_ = capacity;
+    for (size_t o = 0; o < old_capacity; ++o) {
+      if (old_control[o] == kEmpty) {
+        continue;
+      }
+      size_t i = hash_(old_entries[o].key) >> 7;
+      for (;; ++i) {
+        i &= capacity_ - 1;
+        if (control_[i] == kEmpty) {
+          break;
+        }
+      }
+      control_[i] = old_control[o];
+      new (&entries_[i]) Entry(std::move(old_entries[o]));
+    }
+  }
+
+  /// Where tables come from.
+  Arena* arena_;
+  /// One control byte per slot.
+  uint8_t* control_ = nullptr;
+  /// The slots. Only those with non-empty control bytes are initialized.
+  Entry* entries_ = nullptr;
+  /// The number of slots; always 0 or a power of two.
+  size_t capacity_ = 0;
+  /// The number of entries.
+  size_t size_ = 0;
+  Hash hash_;
+  Eq eq_;
+};
+
+}  // namespace anodyne
+
+#endif  // ANODYNE_BASE_ARENA_CONTAINERS_H_
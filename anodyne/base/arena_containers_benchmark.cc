@@ -0,0 +1,141 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/arena_containers.h"
+
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace anodyne {
+namespace {
+
+/// \brief Allocates `count` small nodes in `arena` to use as keys, the way
+/// side tables keyed by tree nodes would see them. The nodes are shuffled,
+/// since passes don't generally visit nodes in allocation order (and
+/// `std::hash`'s identity hash would otherwise get an unrealistically
+/// sequential access pattern).
+std::vector<const void*> MakeNodes(Arena* arena, size_t count) {
+  std::vector<const void*> nodes;
+  nodes.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    nodes.push_back(arena->New(24));
+  }
+  std::shuffle(nodes.begin(), nodes.end(), std::mt19937(count));
+  return nodes;
+}
+
+void BM_ArenaHashMapInsert(benchmark::State& state) {
+  Arena node_arena;
+  auto nodes = MakeNodes(&node_arena, state.range(0));
+  for (auto _ : state) {
+    Arena arena;
+    ArenaHashMap<const void*, uint32_t> map(&arena);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      map.Insert(nodes[i], i);
+    }
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * nodes.size());
+}
+BENCHMARK(BM_ArenaHashMapInsert)->Range(1 << 10, 1 << 20);
+
+void BM_StdUnorderedMapInsert(benchmark::State& state) {
+  Arena node_arena;
+  auto nodes = MakeNodes(&node_arena, state.range(0));
+  for (auto _ : state) {
+    std::unordered_map<const void*, uint32_t> map;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      map.emplace(nodes[i], i);
+    }
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * nodes.size());
+}
+BENCHMARK(BM_StdUnorderedMapInsert)->Range(1 << 10, 1 << 20);
+
+void BM_ArenaHashMapFind(benchmark::State& state) {
+  Arena node_arena;
+  auto nodes = MakeNodes(&node_arena, state.range(0));
+  Arena arena;
+  ArenaHashMap<const void*, uint32_t> map(&arena);
+  for (size_t i = 0; i < nodes.size(); i += 2) {
+    map.Insert(nodes[i], i);
+  }
+  for (auto _ : state) {
+    uint32_t sum = 0;
+    for (const void* node : nodes) {
+      if (const uint32_t* value = map.Find(node)) {
+        sum += *value;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * nodes.size());
+}
+BENCHMARK(BM_ArenaHashMapFind)->Range(1 << 10, 1 << 20);
+
+void BM_StdUnorderedMapFind(benchmark::State& state) {
+  Arena node_arena;
+  auto nodes = MakeNodes(&node_arena, state.range(0));
+  std::unordered_map<const void*, uint32_t> map;
+  for (size_t i = 0; i < nodes.size(); i += 2) {
+    map.emplace(nodes[i], i);
+  }
+  for (auto _ : state) {
+    uint32_t sum = 0;
+    for (const void* node : nodes) {
+      auto it = map.find(node);
+      if (it != map.end()) {
+        sum += it->second;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * nodes.size());
+}
+BENCHMARK(BM_StdUnorderedMapFind)->Range(1 << 10, 1 << 20);
+
+void BM_ArenaVectorPushBack(benchmark::State& state) {
+  for (auto _ : state) {
+    Arena arena;
+    ArenaVector<const void*> vector(&arena);
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      vector.push_back(&vector);
+    }
+    benchmark::DoNotOptimize(vector.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ArenaVectorPushBack)->Range(1 << 10, 1 << 20);
+
+void BM_StdVectorPushBack(benchmark::State& state) {
+  for (auto _ : state) {
+    std::vector<const void*> vector;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      vector.push_back(&vector);
+    }
+    benchmark::DoNotOptimize(vector.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StdVectorPushBack)->Range(1 << 10, 1 << 20);
+
+}  // anonymous namespace
+}  // namespace anodyne
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/arena_containers.h"
+#include "gtest/gtest.h"
+
+#include <unordered_map>
+
+namespace anodyne {
+namespace {
+
+TEST(ArenaVectorTest, PushAndGrow) {
+  Arena arena;
+  ArenaVector<int> vector(&arena);
+  EXPECT_TRUE(vector.empty());
+  for (int i = 0; i < 1000; ++i) {
+    vector.push_back(i);
+  }
+  ASSERT_EQ(1000, vector.size());
+  EXPECT_LE(1000, vector.capacity());
+  int expected = 0;
+  for (int value : vector) {
+    EXPECT_EQ(expected++, value);
+  }
+  EXPECT_EQ(999, vector.back());
+  vector.pop_back();
+  EXPECT_EQ(998, vector.back());
+  vector.resize(1002);
+  EXPECT_EQ(0, vector[1001]);
+  vector.clear();
+  EXPECT_TRUE(vector.empty());
+}
+
+TEST(ArenaVectorTest, Reserve) {
+  Arena arena;
+  ArenaVector<uint64_t> vector(&arena);
+  vector.reserve(100);
+  const uint64_t* data = vector.data();
+  for (uint64_t i = 0; i < 100; ++i) {
+    vector.emplace_back(i);
+  }
+  EXPECT_EQ(data, vector.data());
+}
+
+TEST(ArenaHashMapTest, InsertAndFind) {
+  Arena arena;
+  ArenaHashMap<const void*, int> map(&arena);
+  EXPECT_EQ(nullptr, map.Find(&arena));
+  std::vector<int> keys(10000);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto result = map.Insert(&keys[i], i);
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(i, *result.first);
+  }
+  EXPECT_EQ(keys.size(), map.size());
+  EXPECT_LT(map.size(), map.capacity());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const int* value = map.Find(&keys[i]);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(i, *value);
+  }
+  auto again = map.Insert(&keys[5], 42);
+  EXPECT_FALSE(again.second);
+  EXPECT_EQ(5, *again.first);
+  map[&keys[5]] = 42;
+  EXPECT_EQ(42, *map.Find(&keys[5]));
+  EXPECT_EQ(0, map[&arena]);
+  EXPECT_EQ(keys.size() + 1, map.size());
+}
+
+TEST(ArenaHashMapTest, Iterate) {
+  Arena arena;
+  ArenaHashMap<uint32_t, uint32_t> map(&arena, 100);
+  size_t capacity = map.capacity();
+  for (uint32_t i = 0; i < 100; ++i) {
+    map[i] = i * 2;
+  }
+  EXPECT_EQ(capacity, map.capacity());
+  std::unordered_map<uint32_t, uint32_t> seen;
+  for (const auto& entry : map) {
+    seen[entry.key] = entry.value;
+  }
+  ASSERT_EQ(100, seen.size());
+  for (uint32_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(i * 2, seen[i]);
+  }
+}
+
+}  // anonymous namespace
+}  // namespace anodyne
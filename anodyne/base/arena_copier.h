@@ -0,0 +1,155 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANODYNE_BASE_ARENA_COPIER_H_
+#define ANODYNE_BASE_ARENA_COPIER_H_
+
+#include "anodyne/base/arena.h"
+#include "anodyne/base/symbol_table.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace anodyne {
+
+/// \brief Copies graphs of tt trees into another `Arena`.
+///
+/// Use this to collect the garbage left behind by earlier passes: copy the
+/// trees that are still needed into a fresh `Arena` and then drop the old
+/// one (see `Context::ReplaceArena`). tt generates a `DeepCopy` function for
+/// each datatype that does the work:
+///
+///       ArenaCopier copier(fresh_arena);
+///       root = anodyne::core::exp::DeepCopy(root, &copier);
+///
+/// Nodes reachable more than once are copied once, and the copies are
+/// shared in the same way as the originals. This also holds across calls to
+/// `DeepCopy` that use the same `ArenaCopier`. Copying is iterative, so it
+/// handles arbitrarily deep trees.
+class ArenaCopier {
+ public:
+  /// \brief A function that updates the fields of a freshly copied node to
+  /// refer to copies.
+  using Scavenger = void (*)(const void* node, ArenaCopier* copier);
+
+  explicit ArenaCopier(Arena* arena) : arena_(arena) {}
+  ArenaCopier(const ArenaCopier&) = delete;
+  ArenaCopier& operator=(const ArenaCopier&) = delete;
+
+  /// \return the `Arena` copies are made in.
+  Arena* arena() { return arena_; }
+
+  /// \return the copy of `from`. Only `from` itself is copied; its fields
+  /// are updated later, by `Drain`.
+  template <typename T>
+  const T* Evacuate(const T* from) {
+    return from == nullptr ? nullptr : T::Evacuate(from, this);
+  }
+  template <typename T>
+  const T* Evacuate(const ArenaRef<T>& from) {
+    return Evacuate(from.get());
+  }
+  template <typename T>
+  ArenaSlice<T> Evacuate(const ArenaSlice<T>& from) {
+    auto** contents =
+        static_cast<const T**>(arena_->New(from.size() * sizeof(const T*)));
+    for (size_t i = 0; i < from.size(); ++i) {
+      contents[i] = Evacuate(from[i]);
+    }
+    return ArenaSlice<T>(from.size(), contents);
+  }
+  template <typename T>
+  RelocatableArenaSlice<T> Evacuate(const RelocatableArenaSlice<T>& from) {
+    auto* contents = static_cast<ArenaRef<T>*>(
+        arena_->New(from.size() * sizeof(ArenaRef<T>)));
+    for (size_t i = 0; i < from.size(); ++i) {
+      new (&contents[i]) ArenaRef<T>(Evacuate(from[i]));
+    }
+    return RelocatableArenaSlice<T>(from.size(), contents);
+  }
+  template <typename T>
+  ArenaOption<T> Evacuate(const ArenaOption<T>& from) {
+    return ArenaOption<T>(Evacuate(from.get()));
+  }
+  template <typename T>
+  RelocatableArenaOption<T> Evacuate(const RelocatableArenaOption<T>& from) {
+    return RelocatableArenaOption<T>(Evacuate(from.get()));
+  }
+  ArenaSlice<Symbol> Evacuate(const ArenaSlice<Symbol>& from) {
+    auto* contents =
+        static_cast<Symbol*>(arena_->New(from.size() * sizeof(Symbol)));
+    for (size_t i = 0; i < from.size(); ++i) {
+      contents[i] = from[i];
+    }
+    return ArenaSlice<Symbol>(from.size(), contents);
+  }
+  RelocatableArenaSlice<Symbol> Evacuate(
+      const RelocatableArenaSlice<Symbol>& from) {
+    auto* contents =
+        static_cast<Symbol*>(arena_->New(from.size() * sizeof(Symbol)));
+    for (size_t i = 0; i < from.size(); ++i) {
+      contents[i] = from[i];
+    }
+    return RelocatableArenaSlice<Symbol>(from.size(), contents);
+  }
+  ArenaOption<Symbol> Evacuate(const ArenaOption<Symbol>& from) {
+    return from;
+  }
+  RelocatableArenaOption<Symbol> Evacuate(
+      const RelocatableArenaOption<Symbol>& from) {
+    return from;
+  }
+
+  /// \return the copy previously recorded for `from`, or null.
+  const void* Forwarded(const void* from) const {
+    auto it = forwarding_.find(from);
+    return it == forwarding_.end() ? nullptr : it->second;
+  }
+  /// \brief Records that `to` is the copy of `from` and that `to` still
+  /// needs to have `scavenger` called on it.
+  void Forward(const void* from, const void* to, Scavenger scavenger) {
+    forwarding_.emplace(from, to);
+    pending_.push_back(Pending{to, scavenger});
+  }
+  /// \brief Finishes copying everything reachable from the nodes evacuated
+  /// so far.
+  void Drain() {
+    // `pending_` grows as we go; this visits nodes in breadth-first order.
+    for (size_t i = 0; i < pending_.size(); ++i) {
+      pending_[i].scavenger(pending_[i].node, this);
+    }
+    pending_.clear();
+  }
+  /// \return the number of distinct nodes copied.
+  size_t copied_count() const { return forwarding_.size(); }
+
+ private:
+  /// \brief A copied node whose fields still refer to the originals.
+  struct Pending {
+    const void* node;
+    Scavenger scavenger;
+  };
+  /// Where copies are allocated.
+  Arena* arena_;
+  /// Maps original nodes to their copies.
+  std::unordered_map<const void*, const void*> forwarding_;
+  /// Copies left to scavenge.
+  std::vector<Pending> pending_;
+};
+
+}  // namespace anodyne
+
+#endif  // ANODYNE_BASE_ARENA_COPIER_H_
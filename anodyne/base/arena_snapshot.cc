@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/arena_snapshot.h"
+
+#include "anodyne/base/source.h"
+#include "glog/logging.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace anodyne {
+namespace {
+/// Identifies snapshot files.
+constexpr char kMagic[8] = {'a', 'n', 'o', 'd', 's', 'n', 'a', 'p'};
+/// Changes whenever the layout of snapshot files does.
+constexpr uint32_t kVersion = 2;
+
+/// \brief The start of a snapshot file.
+///
+/// The header is followed by `root_count` `uint64_t` root offsets (relative
+/// to the start of the arena data), `symbol_count` `uint32_t` symbol text
+/// lengths, the concatenated symbol texts, and then (starting on a page
+/// boundary at `data_offset`) `data_size` bytes of arena data.
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t pointer_size;
+  uint32_t location_size;
+  uint32_t reserved;
+  uint64_t root_count;
+  uint64_t symbol_count;
+  uint64_t symbol_bytes;
+  uint64_t gensym_limit;
+  uint64_t data_offset;
+  uint64_t data_size;
+};
+
+/// \brief Writes `size` bytes from `data` to `file`.
+/// \return false on failure.
+bool WriteBytes(const void* data, size_t size, FILE* file) {
+  return size == 0 || fwrite(data, size, 1, file) == 1;
+}
+}  // anonymous namespace
+
+ArenaSnapshot::~ArenaSnapshot() { munmap(mapping_, mapping_size_); }
+
+bool ArenaSnapshot::Write(const Arena& arena, const SymbolTable& symbol_table,
+                          const std::vector<const void*>& roots,
+                          const std::string& path) {
+  const char* data;
+  size_t data_size;
+  if (!arena.ContiguousExtent(&data, &data_size)) {
+    LOG(ERROR) << "only arenas with the mmap backend can be snapshotted";
+    return false;
+  }
+  std::vector<uint64_t> root_offsets;
+  root_offsets.reserve(roots.size());
+  for (const void* root : roots) {
+    const char* address = static_cast<const char*>(root);
+    if (address < data || address >= data + data_size) {
+      LOG(ERROR) << "snapshot root " << root << " is not in the arena";
+      return false;
+    }
+    root_offsets.push_back(address - data);
+  }
+  std::vector<uint32_t> symbol_lengths;
+  symbol_lengths.reserve(symbol_table.symbol_count());
+  uint64_t symbol_bytes = 0;
+  for (Symbol s = 0; s < symbol_table.symbol_count(); ++s) {
+    symbol_lengths.push_back(symbol_table.Text(s).size());
+    symbol_bytes += symbol_lengths.back();
+  }
+  const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.pointer_size = sizeof(void*);
+  header.location_size = sizeof(Location);
+  header.reserved = 0;
+  header.root_count = root_offsets.size();
+  header.symbol_count = symbol_lengths.size();
+  header.symbol_bytes = symbol_bytes;
+  header.gensym_limit = symbol_table.gensym_limit();
+  uint64_t preamble_size = sizeof(Header) +
+                           root_offsets.size() * sizeof(uint64_t) +
+                           symbol_lengths.size() * sizeof(uint32_t) +
+                           symbol_bytes;
+  header.data_offset = (preamble_size + page_size - 1) / page_size * page_size;
+  header.data_size = data_size;
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    PLOG(ERROR) << "could not open " << path;
+    return false;
+  }
+  bool ok = WriteBytes(&header, sizeof(header), file) &&
+            WriteBytes(root_offsets.data(),
+                       root_offsets.size() * sizeof(uint64_t), file) &&
+            WriteBytes(symbol_lengths.data(),
+                       symbol_lengths.size() * sizeof(uint32_t), file);
+  for (Symbol s = 0; ok && s < symbol_table.symbol_count(); ++s) {
+    auto text = symbol_table.Text(s);
+    ok = WriteBytes(text.data(), text.size(), file);
+  }
+  if (ok) {
+    std::vector<char> padding(header.data_offset - preamble_size, 0);
+    ok = WriteBytes(padding.data(), padding.size(), file) &&
+         WriteBytes(data, data_size, file);
+  }
+  if (!ok) {
+    PLOG(ERROR) << "could not write " << path;
+  }
+  if (fclose(file) != 0) {
+    PLOG(ERROR) << "could not close " << path;
+    ok = false;
+  }
+  return ok;
+}
+
+std::unique_ptr<ArenaSnapshot> ArenaSnapshot::Open(const std::string& path,
+                                                   SymbolTable* symbol_table) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    PLOG(ERROR) << "could not open " << path;
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    PLOG(ERROR) << "could not stat " << path;
+    close(fd);
+    return nullptr;
+  }
+  size_t file_size = st.st_size;
+  if (file_size < sizeof(Header)) {
+    LOG(ERROR) << path << " is too small to be a snapshot";
+    close(fd);
+    return nullptr;
+  }
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "could not map " << path;
+    return nullptr;
+  }
+  // Take ownership of the mapping now so that it is released on failure.
+  std::unique_ptr<ArenaSnapshot> snapshot(
+      new ArenaSnapshot(mapping, file_size));
+  const char* bytes = static_cast<const char*>(mapping);
+  Header header;
+  memcpy(&header, bytes, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.pointer_size != sizeof(void*) ||
+      header.location_size != sizeof(Location)) {
+    LOG(ERROR) << path << " is not a compatible snapshot";
+    return nullptr;
+  }
+  uint64_t preamble_size = sizeof(Header) +
+                           header.root_count * sizeof(uint64_t) +
+                           header.symbol_count * sizeof(uint32_t) +
+                           header.symbol_bytes;
+  if (header.root_count > file_size || header.symbol_count > file_size ||
+      header.symbol_bytes > file_size || preamble_size > header.data_offset ||
+      header.data_offset > file_size ||
+      header.data_size > file_size - header.data_offset) {
+    LOG(ERROR) << path << " is truncated or corrupt";
+    return nullptr;
+  }
+  const char* cursor = bytes + sizeof(Header);
+  const char* data = bytes + header.data_offset;
+  snapshot->roots_.reserve(header.root_count);
+  for (uint64_t r = 0; r < header.root_count; ++r) {
+    uint64_t offset;
+    memcpy(&offset, cursor, sizeof(offset));
+    cursor += sizeof(offset);
+    if (offset >= header.data_size) {
+      LOG(ERROR) << path << " has a root outside of its data";
+      return nullptr;
+    }
+    snapshot->roots_.push_back(data + offset);
+  }
+  const char* text = cursor + header.symbol_count * sizeof(uint32_t);
+  uint64_t text_left = header.symbol_bytes;
+  for (uint64_t s = 0; s < header.symbol_count; ++s) {
+    uint32_t length;
+    memcpy(&length, cursor, sizeof(length));
+    cursor += sizeof(length);
+    if (length > text_left) {
+      LOG(ERROR) << path << " is truncated or corrupt";
+      return nullptr;
+    }
+    text_left -= length;
+    if (symbol_table->Intern(absl::string_view(text, length)) != s) {
+      LOG(ERROR) << path << " has symbols that disagree with the table";
+      return nullptr;
+    }
+    text += length;
+  }
+  symbol_table->ReserveGensyms(header.gensym_limit);
+  return snapshot;
+}
+
+}  // namespace anodyne
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANODYNE_BASE_ARENA_SNAPSHOT_H_
+#define ANODYNE_BASE_ARENA_SNAPSHOT_H_
+
+#include "anodyne/base/arena.h"
+#include "anodyne/base/symbol_table.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace anodyne {
+
+/// \brief A read-only copy of an `Arena`'s contents that has been written
+/// to a file and mapped back into memory.
+///
+/// Snapshots let a program skip rebuilding trees it has built before. The
+/// snapshotted `Arena` must use `ArenaBackend::kMmap` and its objects must
+/// refer to one another only through `ArenaRef`s (as do the types that tt
+/// generates for a `relocatable` library). Objects in a snapshot are used
+/// in place, without any per-object fixup.
+///
+/// `Symbol`s are stored as they are; the `SymbolTable` they came from is
+/// saved alongside the arena and is replayed into the loading
+/// `SymbolTable`. `Range`s are also stored as they are, so they only make
+/// sense if the loading program's `Source` assigns the same locations.
+class ArenaSnapshot {
+ public:
+  ArenaSnapshot(const ArenaSnapshot&) = delete;
+  ArenaSnapshot& operator=(const ArenaSnapshot&) = delete;
+  ~ArenaSnapshot();
+
+  /// \brief Writes the contents of `arena` and `symbol_table` to `path`.
+  /// \param roots objects in `arena` to make available from the snapshot.
+  /// \return false on failure.
+  static bool Write(const Arena& arena, const SymbolTable& symbol_table,
+                    const std::vector<const void*>& roots,
+                    const std::string& path);
+
+  /// \brief Maps the snapshot at `path` into memory.
+  ///
+  /// The snapshot's symbols are interned into `symbol_table`. This fails
+  /// unless each one gets the same `Symbol` it had when the snapshot was
+  /// written, which is always true if `symbol_table` starts out empty.
+  /// \return null on failure.
+  static std::unique_ptr<ArenaSnapshot> Open(const std::string& path,
+                                             SymbolTable* symbol_table);
+
+  /// \return the number of roots passed to `Write`.
+  size_t root_count() const { return roots_.size(); }
+  /// \return the `index`th root passed to `Write`.
+  template <typename T>
+  const T* root(size_t index) const {
+    return static_cast<const T*>(roots_[index]);
+  }
+
+ private:
+  ArenaSnapshot(void* mapping, size_t mapping_size)
+      : mapping_(mapping), mapping_size_(mapping_size) {}
+  /// The mapped file.
+  void* mapping_;
+  /// The size of `mapping_` in bytes.
+  size_t mapping_size_;
+  /// Roots, pointing into `mapping_`.
+  std::vector<const void*> roots_;
+};
+
+}  // namespace anodyne
+
+#endif  // ANODYNE_BASE_ARENA_SNAPSHOT_H_
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/arena_snapshot.h"
+#include "gtest/gtest.h"
+
+namespace anodyne {
+namespace {
+
+struct Node : public ArenaObject {
+  Symbol name;
+  ArenaRef<Node> next;
+  RelocatableArenaSlice<Symbol> tags;
+};
+
+Arena::Options MmapOptions() {
+  Arena::Options options;
+  options.backend = ArenaBackend::kMmap;
+  options.mmap_reserve_bytes = 1024 * 1024;
+  options.mmap_commit_bytes = 4096;
+  return options;
+}
+
+TEST(ArenaSnapshotTest, RoundTrip) {
+  std::string path = ::testing::TempDir() + "/round_trip.snapshot";
+  {
+    Arena arena(MmapOptions());
+    SymbolTable symbols;
+    Node* head = nullptr;
+    for (int i = 0; i < 100; ++i) {
+      auto* node = new (&arena) Node();
+      node->name = symbols.Intern("node" + std::to_string(i));
+      node->next = head;
+      Symbol tags[] = {symbols.Intern("tag"), symbols.Gensym()};
+      node->tags = RelocatableArenaSlice<Symbol>::Copy(
+          &arena, ArenaSlice<Symbol>(2, tags));
+      head = node;
+    }
+    ASSERT_TRUE(ArenaSnapshot::Write(arena, symbols, {head}, path));
+  }
+  SymbolTable symbols;
+  auto snapshot = ArenaSnapshot::Open(path, &symbols);
+  ASSERT_NE(nullptr, snapshot);
+  ASSERT_EQ(1, snapshot->root_count());
+  int count = 0;
+  for (const Node* node = snapshot->root<Node>(0); node != nullptr;
+       node = node->next) {
+    EXPECT_EQ("node" + std::to_string(99 - count), symbols.Text(node->name));
+    ASSERT_EQ(2, node->tags.size());
+    EXPECT_EQ("tag", symbols.Text(node->tags[0]));
+    EXPECT_TRUE(symbols.is_gensym(node->tags[1]));
+    ++count;
+  }
+  EXPECT_EQ(100, count);
+  // Gensyms made after loading must not collide with those in the snapshot.
+  EXPECT_GT(symbols.Gensym(), snapshot->root<Node>(0)->tags[1]);
+}
+
+TEST(ArenaSnapshotTest, RejectsHeapArena) {
+  Arena arena;
+  SymbolTable symbols;
+  auto* node = new (&arena) Node();
+  EXPECT_FALSE(ArenaSnapshot::Write(arena, symbols, {node},
+                                    ::testing::TempDir() + "/heap.snapshot"));
+}
+
+TEST(ArenaSnapshotTest, RejectsConflictingSymbols) {
+  std::string path = ::testing::TempDir() + "/conflict.snapshot";
+  {
+    Arena arena(MmapOptions());
+    SymbolTable symbols;
+    auto* node = new (&arena) Node();
+    node->name = symbols.Intern("a");
+    ASSERT_TRUE(ArenaSnapshot::Write(arena, symbols, {node}, path));
+  }
+  SymbolTable symbols;
+  symbols.Intern("b");
+  EXPECT_EQ(nullptr, ArenaSnapshot::Open(path, &symbols));
+}
+
+}  // anonymous namespace
+}  // namespace anodyne
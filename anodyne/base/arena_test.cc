@@ -18,6 +18,10 @@
 
 #include "gtest/gtest.h"
 
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace anodyne {
 namespace {
 
@@ -37,6 +41,14 @@ struct Big : public ArenaObject {
 struct Huge : public ArenaObject {
   uint8_t huge[1024 * 65];
 };
+/// Appends its name to a log when destroyed.
+struct Logged : public ArenaObject {
+  Logged(std::vector<std::string>* log, std::string name)
+      : log(log), name(std::move(name)) {}
+  ~Logged() { log->push_back(name); }
+  std::vector<std::string>* log;
+  std::string name;
+};
 
 static_assert(sizeof(Zero) == 1, "strange environment");
 static_assert(sizeof(One) == 1, "strange environment");
@@ -72,5 +84,313 @@ TEST(ArenaTest, AllocateBig) {
   EXPECT_EQ(0, arena.huge_block_count());
 }
 
+TEST(ArenaTest, AllocateAligned) {
+  Arena arena;
+  new (&arena) One();
+  for (size_t alignment : {16, 32, 64, 4096}) {
+    void* aligned = arena.New(24, alignment);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(aligned) % alignment);
+    new (&arena) Nine();
+  }
+  EXPECT_EQ(1, arena.block_count());
+  void* huge = arena.New(1024 * 64, 64);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(huge) % 64);
+  EXPECT_EQ(1, arena.huge_block_count());
+}
+
+TEST(ArenaTest, GeometricBlockGrowth) {
+  Arena::Options options;
+  options.initial_block_size = 1024;
+  options.max_block_size = 4096;
+  options.growth_factor = 2;
+  Arena arena(options);
+  // Each allocation fills more than half of the biggest block, so each
+  // needs a block of its own: 1024, 2048, 4096, 4096.
+  arena.New(1000);
+  arena.New(1500);
+  EXPECT_EQ(2, arena.block_count());
+  arena.New(2100);
+  arena.New(2100);
+  EXPECT_EQ(4, arena.block_count());
+  EXPECT_EQ(0, arena.huge_block_count());
+  arena.New(4097);
+  EXPECT_EQ(1, arena.huge_block_count());
+  // Small blocks left behind by rewinding are skipped for big requests.
+  Arena rewound(options);
+  auto mark = rewound.Mark();
+  rewound.New(1000);
+  rewound.New(2000);
+  rewound.Rewind(mark);
+  rewound.New(1500);
+  EXPECT_EQ(2, rewound.block_count());
+}
+
+TEST(ArenaTest, RewindReusesBlocks) {
+  Arena arena;
+  auto* one = new (&arena) One();
+  auto mark = arena.Mark();
+  auto* eight = new (&arena) Eight();
+  auto* big = new (&arena) Big();
+  new (&arena) Huge();
+  EXPECT_EQ(2, arena.block_count());
+  EXPECT_EQ(1, arena.huge_block_count());
+  arena.Rewind(mark);
+  EXPECT_EQ(0, arena.huge_block_count());
+  EXPECT_EQ(eight, new (&arena) Eight());
+  EXPECT_EQ(big, new (&arena) Big());
+  EXPECT_EQ(2, arena.block_count());
+  EXPECT_EQ(kPointerSize, offset(one, eight));
+}
+
+TEST(ArenaTest, RewindEmptyArena) {
+  Arena arena;
+  auto mark = arena.Mark();
+  auto* first = new (&arena) Eight();
+  arena.Rewind(mark);
+  EXPECT_EQ(first, new (&arena) Eight());
+  EXPECT_EQ(1, arena.block_count());
+}
+
+TEST(ArenaTest, ArenaRewinder) {
+  Arena arena;
+  new (&arena) One();
+  void* speculative;
+  {
+    ArenaRewinder rewinder(&arena);
+    speculative = new (&arena) Nine();
+    new (&arena) Huge();
+    EXPECT_EQ(1, arena.huge_block_count());
+  }
+  EXPECT_EQ(0, arena.huge_block_count());
+  EXPECT_EQ(speculative, new (&arena) Nine());
+}
+
+TEST(ArenaTest, BlockPoolRecyclesBlocks) {
+  ArenaBlockPool pool;
+  Arena::Options options;
+  options.block_pool = &pool;
+  void* first_block;
+  {
+    Arena arena(options);
+    first_block = new (&arena) Eight();
+    new (&arena) Big();
+    EXPECT_EQ(2, arena.block_count());
+    EXPECT_EQ(0, pool.free_block_count());
+  }
+  EXPECT_EQ(2, pool.free_block_count());
+  Arena arena(options);
+  // The most recently released block is handed out first.
+  EXPECT_NE(first_block, new (&arena) Eight());
+  new (&arena) Big();
+  EXPECT_EQ(0, pool.free_block_count());
+  // Blocks of other sizes don't come from the pool.
+  options.initial_block_size = 1024;
+  options.max_block_size = 1024;
+  { Arena small(options); small.New(8); }
+  EXPECT_EQ(0, pool.free_block_count());
+}
+
+TEST(ArenaTest, BlockPoolLimits) {
+  ArenaBlockPool::Options pool_options;
+  pool_options.max_bytes = 3 * Arena::kDefaultBlockSize;
+  pool_options.retain_bytes = Arena::kDefaultBlockSize;
+  ArenaBlockPool pool(pool_options);
+  std::vector<char*> blocks;
+  for (int i = 0; i < 4; ++i) {
+    blocks.push_back(pool.Allocate());
+    blocks.back()[0] = 1;
+  }
+  for (auto* block : blocks) {
+    pool.Release(block);
+  }
+  EXPECT_EQ(3, pool.free_block_count());
+  EXPECT_EQ(2, pool.trimmed_block_count());
+  pool.Trim(0);
+  EXPECT_EQ(3, pool.trimmed_block_count());
+  // Trimmed blocks are still usable.
+  char* block = pool.Allocate();
+  block[0] = 2;
+  EXPECT_EQ(2, pool.trimmed_block_count());
+  pool.SetLimits(Arena::kDefaultBlockSize, 0);
+  EXPECT_EQ(1, pool.free_block_count());
+  pool.Release(block);
+  EXPECT_EQ(1, pool.free_block_count());
+}
+
+TEST(ArenaTest, MmapBackend) {
+  Arena::Options options;
+  options.backend = ArenaBackend::kMmap;
+  options.mmap_reserve_bytes = 8 * 1024 * 1024;
+  options.mmap_commit_bytes = 64 * 1024;
+  Arena arena(options);
+  auto mark = arena.Mark();
+  auto* one = new (&arena) One();
+  auto* huge = new (&arena) Huge();
+  auto* eight = new (&arena) Eight();
+  // Everything, including huge allocations, comes from one region.
+  EXPECT_EQ(kPointerSize, offset(one, huge));
+  EXPECT_EQ(kPointerSize + sizeof(Huge), offset(one, eight));
+  EXPECT_EQ(0, arena.block_count());
+  EXPECT_EQ(0, arena.huge_block_count());
+  void* aligned = arena.New(100, 64);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(aligned) % 64);
+  arena.Rewind(mark);
+  EXPECT_EQ(one, new (&arena) One());
+  EXPECT_THROW(arena.New(8 * 1024 * 1024), std::bad_alloc);
+}
+
+TEST(ArenaTest, Stats) {
+  Arena arena;
+  new (&arena) One();
+  new (&arena) Nine();
+  new (&arena) Big();
+  new (&arena) Huge();
+  ArenaStats stats = arena.stats();
+  EXPECT_EQ(4, stats.allocation_count);
+  EXPECT_EQ(1 + 9 + sizeof(Big) + sizeof(Huge), stats.requested_bytes);
+  // One and Nine are rounded up to a multiple of kPointerSize.
+  size_t rounding = (kPointerSize - 1) + (2 * kPointerSize - 9);
+  EXPECT_EQ(rounding, stats.alignment_bytes);
+  // Big didn't fit in the first block after One and Nine.
+  EXPECT_EQ(Arena::kDefaultBlockSize - 3 * kPointerSize, stats.tail_bytes);
+  EXPECT_EQ(1, stats.huge_histogram[16]);
+  // Aligning to 64 bytes skips up to 64 - kPointerSize bytes.
+  arena.New(8, 64);
+  stats = arena.stats();
+  EXPECT_LE(rounding, stats.alignment_bytes);
+  EXPECT_GT(rounding + 64, stats.alignment_bytes);
+  // Rewinding doesn't forget earlier rounding.
+  size_t aligned = stats.alignment_bytes;
+  auto mark = arena.Mark();
+  arena.New(1);
+  arena.Rewind(mark);
+  arena.New(1);
+  EXPECT_EQ(aligned + 2 * (kPointerSize - 1), arena.stats().alignment_bytes);
+}
+
+TEST(ArenaTest, Accounts) {
+  static constexpr ArenaAccount kLeaf{"tree", "Leaf"};
+  static constexpr ArenaAccount kNode{"tree", "Node"};
+  Arena untracked;
+  untracked.Charge(&kLeaf, 8);
+  EXPECT_TRUE(untracked.stats().accounts.empty());
+  Arena::Options options;
+  options.track_accounts = true;
+  Arena arena(options);
+  arena.Charge(&kLeaf, 8);
+  arena.Charge(&kLeaf, 8);
+  arena.Charge(&kNode, 24);
+  ArenaStats stats = arena.stats();
+  EXPECT_EQ(2, stats.accounts[&kLeaf].count);
+  EXPECT_EQ(16, stats.accounts[&kLeaf].bytes);
+  EXPECT_EQ(24, stats.accounts[&kNode].bytes);
+  stats.Merge(arena.stats());
+  EXPECT_EQ(4, stats.accounts[&kLeaf].count);
+  EXPECT_NE(std::string::npos,
+            stats.ToString().find("tree: 6 allocations, 80 bytes\n"
+                                  "  Node: 2 allocations, 48 bytes\n"
+                                  "  Leaf: 4 allocations, 32 bytes\n"));
+}
+
+TEST(ArenaTest, CreateRunsDestructorsInReverse) {
+  std::vector<std::string> log;
+  {
+    Arena arena;
+    auto* first = arena.Create<Logged>(&log, "first");
+    auto* eight = arena.Create<Eight>();
+    arena.Create<Logged>(&log, "second");
+    EXPECT_EQ("first", first->name);
+    EXPECT_EQ(0, eight->eight);
+    // Only `Logged` needs cleaning up.
+    EXPECT_EQ(2, arena.stats().cleanup_count);
+    EXPECT_TRUE(log.empty());
+  }
+  EXPECT_EQ((std::vector<std::string>{"second", "first"}), log);
+}
+
+TEST(ArenaTest, RewindRunsCleanups) {
+  std::vector<std::string> log;
+  int counter = 0;
+  {
+    Arena arena;
+    arena.Create<Logged>(&log, "kept");
+    {
+      ArenaRewinder rewinder(&arena);
+      arena.Create<Logged>(&log, "rewound");
+    }
+    EXPECT_EQ((std::vector<std::string>{"rewound"}), log);
+    arena.Create<Logged>(&log, "later");
+    arena.RegisterCleanup(&counter, [](void* c) { ++*static_cast<int*>(c); });
+    log.clear();
+  }
+  EXPECT_EQ(1, counter);
+  EXPECT_EQ((std::vector<std::string>{"later", "kept"}), log);
+}
+
+TEST(ArenaTest, ArenaRefSurvivesMoves) {
+  Arena arena;
+  auto* target = new (&arena) Eight();
+  ArenaRef<Eight> ref(target);
+  EXPECT_EQ(target, ref.get());
+  alignas(ArenaRef<Eight>) char moved[sizeof(ArenaRef<Eight>) * 2];
+  auto* copy = new (moved + sizeof(ArenaRef<Eight>)) ArenaRef<Eight>(ref);
+  EXPECT_EQ(target, copy->get());
+  ArenaRef<Eight> null_ref;
+  EXPECT_EQ(nullptr, null_ref.get());
+  ref = nullptr;
+  EXPECT_EQ(nullptr, ref.get());
+  const Eight* items[] = {target, nullptr};
+  auto slice = RelocatableArenaSlice<Eight>::Copy(
+      &arena, ArenaSlice<Eight>(2, items));
+  EXPECT_EQ(2, slice.size());
+  EXPECT_EQ(target, slice[0]);
+  EXPECT_EQ(nullptr, slice[1]);
+  RelocatableArenaOption<Eight> option = Some(target);
+  EXPECT_TRUE(option.is_some());
+  EXPECT_EQ(target, option.get());
+}
+
+TEST(ArenaTest, ShardedArenaPerThread) {
+  ShardedArena sharded;
+  Arena* main_arena = sharded.ThreadArena();
+  EXPECT_EQ(main_arena, sharded.ThreadArena());
+  Arena* other_arena = nullptr;
+  std::thread other([&] { other_arena = sharded.ThreadArena(); });
+  other.join();
+  EXPECT_NE(nullptr, other_arena);
+  EXPECT_NE(main_arena, other_arena);
+  EXPECT_EQ(2, sharded.shard_count());
+  // A second ShardedArena must not reuse this thread's cached shard.
+  ShardedArena another;
+  EXPECT_NE(main_arena, another.ThreadArena());
+  EXPECT_EQ(main_arena, sharded.ThreadArena());
+}
+
+TEST(ArenaTest, ShardedArenaConcurrentAllocation) {
+  constexpr int kThreads = 4;
+  constexpr int kAllocations = 10000;
+  ShardedArena sharded;
+  std::vector<std::vector<Eight*>> allocations(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&sharded, &allocations, t] {
+      for (int i = 0; i < kAllocations; ++i) {
+        auto* eight = new (sharded.ThreadArena()) Eight();
+        eight->eight = t * kAllocations + i;
+        allocations[t].push_back(eight);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kThreads, sharded.shard_count());
+  for (int t = 0; t < kThreads; ++t) {
+    for (int i = 0; i < kAllocations; ++i) {
+      EXPECT_EQ(t * kAllocations + i, allocations[t][i]->eight);
+    }
+  }
+}
+
 }  // anonymous namespace
 }  // namespace anodyne
@@ -16,8 +16,16 @@
 
 #include "anodyne/base/context.h"
 
+#include "glog/logging.h"
+
 namespace anodyne {
 
+Context::~Context() {
+  if (dump_arena_stats_) {
+    LOG(INFO) << "arena stats:\n" << arena_stats().ToString();
+  }
+}
+
 thread_local Context* Context::current_ = nullptr;
 
 }  // namespace anodyne
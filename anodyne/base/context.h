@@ -17,20 +17,64 @@
 #ifndef ANODYNE_BASE_CONTEXT_H__
 #define ANODYNE_BASE_CONTEXT_H__
 
+#include "absl/memory/memory.h"
 #include "anodyne/base/arena.h"
 #include "anodyne/base/source.h"
 #include "anodyne/base/symbol_table.h"
 
+#include <cassert>
 #include <memory>
 
 namespace anodyne {
 
 class Context {
  public:
+  /// \brief Configures a `Context`.
+  struct Options {
+    /// If true, each thread bound to the `Context` allocates from its own
+    /// `Arena`, so that many threads may build trees in it at once. Note
+    /// that the `Context`'s `Source` is still not thread-safe.
+    bool sharded_arena = false;
+    /// Configures the `Context`'s `Arena` (or each of its shards).
+    Arena::Options arena;
+    /// If true, the `Context` logs its `arena_stats()` when destroyed.
+    bool dump_arena_stats = false;
+    /// Configures the `Context`'s `SymbolTable`. Set `concurrent` (along
+    /// with `sharded_arena`) to build trees from several threads at once.
+    SymbolTable::Options symbol_table;
+  };
   Context() {}
+  explicit Context(const Options& options)
+      : arena_(absl::make_unique<Arena>(options.arena)),
+        dump_arena_stats_(options.dump_arena_stats),
+        symbol_table_(options.symbol_table) {
+    if (options.sharded_arena) {
+      sharded_arena_ = absl::make_unique<ShardedArena>(options.arena);
+    }
+  }
+  ~Context();
   Context(const Context&) = delete;
   Context& operator=(const Context&) = delete;
-  Arena* arena() { return &arena_; }
+  /// \return the `Arena` the current thread should allocate from.
+  Arena* arena() {
+    return sharded_arena_ ? sharded_arena_->ThreadArena() : arena_.get();
+  }
+  /// \brief Makes `arena` the `Context`'s `Arena`.
+  ///
+  /// Together with `ArenaCopier`, this lets long-lived `Context`s drop the
+  /// nodes that earlier passes left behind: copy the trees that are still
+  /// needed into a new `Arena`, then swap it in and destroy the old one.
+  /// Must not be used with a sharded arena.
+  /// \return the previous `Arena`.
+  std::unique_ptr<Arena> ReplaceArena(std::unique_ptr<Arena> arena) {
+    assert(!sharded_arena_);
+    arena_.swap(arena);
+    return arena;
+  }
+  /// \return statistics about every allocation made in this `Context`.
+  ArenaStats arena_stats() const {
+    return sharded_arena_ ? sharded_arena_->stats() : arena_->stats();
+  }
   SymbolTable* symbol_table() { return &symbol_table_; }
   const SymbolTable* symbol_table() const { return &symbol_table_; }
   Source* source() { return &source_; }
@@ -41,7 +85,11 @@ class Context {
  private:
   friend class ContextBinding;
 
-  Arena arena_;
+  std::unique_ptr<Arena> arena_ = absl::make_unique<Arena>();
+  /// If set, replaces `arena_` as the source of allocations.
+  std::unique_ptr<ShardedArena> sharded_arena_;
+  /// Whether to log `arena_stats()` on destruction.
+  bool dump_arena_stats_ = false;
   Source source_;
   SymbolTable symbol_table_;
   static thread_local Context* current_;
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANODYNE_BASE_PERFECT_HASH_H_
+#define ANODYNE_BASE_PERFECT_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace anodyne {
+namespace perfect_hash {
+
+// These are shared by //anodyne/tools:symbol_gen, which searches for a seed
+// that makes `Hash` collision-free over a set of strings, and the tables it
+// generates. They're written as single-expression recursive functions so
+// that they can be evaluated at compile time under C++11; callers should
+// bound `size` before using them at run time.
+
+/// \return the FNV-1a hash of `size` bytes at `text` starting from `hash`.
+constexpr uint32_t Fnv1a(const char* text, size_t size, uint32_t hash) {
+  return size == 0 ? hash
+                   : Fnv1a(text + 1, size - 1,
+                           (hash ^ static_cast<uint8_t>(*text)) * 16777619u);
+}
+
+/// \return `hash` with its high bits folded into its low ones.
+constexpr uint32_t Fold(uint32_t hash) { return hash ^ (hash >> 15); }
+
+/// \return the hash of `size` bytes at `text` under `seed`. The low bits are
+/// suitable for indexing a power-of-two-sized table.
+constexpr uint32_t Hash(const char* text, size_t size, uint32_t seed) {
+  return Fold(Fnv1a(text, size, 2166136261u ^ (seed * 0x9e3779b9u)));
+}
+
+/// \return whether the `size` bytes at `lhs` and `rhs` are the same.
+constexpr bool Equal(const char* lhs, const char* rhs, size_t size) {
+  return size == 0 || (*lhs == *rhs && Equal(lhs + 1, rhs + 1, size - 1));
+}
+
+}  // namespace perfect_hash
+}  // namespace anodyne
+
+#endif  // ANODYNE_BASE_PERFECT_HASH_H_
@@ -19,8 +19,22 @@
 #include "glog/logging.h"
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
+#include <unordered_set>
 
 namespace anodyne {
+namespace {
+/// \return a `FileId` with the given parts.
+FileId MakeFileId(absl::string_view repository, absl::string_view path,
+                  absl::string_view root) {
+  FileId id;
+  id.repository_id = std::string(repository);
+  id.local_path = std::string(path);
+  id.root_path = std::string(root);
+  return id;
+}
+}  // anonymous namespace
 
 std::string Range::ToString(const Source& source) const {
   const File* lhs = source.FindFile(begin);
@@ -58,36 +72,286 @@ absl::string_view File::Text(Location begin, Location end) const {
       end.data() > end_.data()) {
     return "";
   }
-  return absl::string_view(contents_.content())
-      .substr(begin.data() - begin_.data(), end.data() - begin.data());
+  absl::string_view content = contents().content();
+  size_t offset = begin.data() - begin_.data();
+  size_t size = end.data() - begin.data();
+  // Lazily loaded contents may be missing (or may have changed size).
+  if (offset + size > content.size()) {
+    return "";
+  }
+  return content.substr(offset, size);
+}
+
+File::File(const FileId& id, int size, FileLoader loader, Location begin,
+           Source* source)
+    : id_(id),
+      loader_(std::move(loader)),
+      source_(source),
+      clock_(&source->use_clock_),
+      begin_(begin),
+      end_(begin.offset(size)) {}
+
+const SourceBuffer& File::Load() const {
+  auto buffer = loader_(id_);
+  if (buffer == nullptr) {
+    LOG(ERROR) << "couldn't load " << id_.ToString();
+    // Don't keep retrying. The shared empty buffer is always pinned, so
+    // this is never evicted.
+    contents_ = EmptyContents();
+  } else if (begin_.offset(buffer->max_offset()).data() != end_.data()) {
+    LOG(ERROR) << id_.ToString() << " changed size since it was found";
+    contents_ = EmptyContents();
+  } else {
+    contents_ = source_->ShareContents(std::move(buffer));
+  }
+  return *contents_;
+}
+
+std::shared_ptr<const SourceBuffer> File::EmptyContents() {
+  static const auto* empty =
+      new std::shared_ptr<const SourceBuffer>(std::make_shared<SourceBuffer>(
+          absl::string_view(), SourceMap{}));
+  return *empty;
+}
+
+const File* Source::LookupFile(absl::string_view repository,
+                               absl::string_view path,
+                               absl::string_view root) {
+  FileKey key;
+  // If any part of the id hasn't been interned, the file can't be here.
+  if (file_id_symbols_.Find(repository, &key.repository) &&
+      file_id_symbols_.Find(path, &key.path) &&
+      file_id_symbols_.Find(root, &key.root)) {
+    if (const File* const* file = file_map_.Find(key)) {
+      return *file;
+    }
+  }
+  return nullptr;
+}
+
+bool Source::ReserveLocations(const FileId& id, int size, Location* begin) {
+  Location::Rep to_allocate = size;
+  // Make sure that all files have at least one unique location.
+  if (to_allocate == 0) to_allocate = 1;
+  if (std::numeric_limits<Location::Rep>::max() - max_location_.data() <
+      to_allocate) {
+    LOG(ERROR) << "out of location space for " << id.ToString()
+               << "; build with --define anodyne_wide_locations=1";
+    return false;
+  }
+  LOG(INFO) << "allocating " << to_allocate << " bytes of address space";
+  *begin = max_location_;
+  max_location_ = Location::FromRep(max_location_.data() + to_allocate);
+  return true;
+}
+
+const File* Source::AddFile(std::unique_ptr<File> file) {
+  const FileId& id = file->id();
+  FileKey key{file_id_symbols_.Intern(id.repository_id),
+              file_id_symbols_.Intern(id.local_path),
+              file_id_symbols_.Intern(id.root_path)};
+  files_.push_back(std::move(file));
+  file_map_.Insert(key, files_.back().get());
+  return files_.back().get();
+}
+
+namespace {
+/// \return a hash of `buffer`'s content.
+size_t HashContents(const SourceBuffer& buffer) {
+  return absl::Hash<absl::string_view>()(buffer.content());
+}
+}  // anonymous namespace
+
+std::shared_ptr<const SourceBuffer> Source::ShareContents(
+    std::unique_ptr<SourceBuffer> buffer) {
+  if (!buffer->source_map().segments().empty()) {
+    return buffer;
+  }
+  std::shared_ptr<const SourceBuffer> contents = std::move(buffer);
+  auto& sized = contents_by_size_[contents->content().size()];
+  if (sized.by_hash.empty()) {
+    auto first = sized.unhashed.lock();
+    if (first == nullptr) {
+      // Most files differ in size, so only hash contents that need it.
+      sized.unhashed = contents;
+      return contents;
+    }
+    sized.unhashed.reset();
+    sized.by_hash.emplace(HashContents(*first), std::move(first));
+  }
+  size_t hash = HashContents(*contents);
+  auto range = sized.by_hash.equal_range(hash);
+  for (auto i = range.first; i != range.second;) {
+    auto existing = i->second.lock();
+    if (existing == nullptr) {
+      i = sized.by_hash.erase(i);
+    } else if (existing->content() == contents->content()) {
+      return existing;
+    } else {
+      ++i;
+    }
+  }
+  sized.by_hash.emplace(hash, contents);
+  return contents;
+}
+
+void Source::SweepContents() {
+  for (auto sized = contents_by_size_.begin();
+       sized != contents_by_size_.end();) {
+    auto& by_hash = sized->second.by_hash;
+    for (auto i = by_hash.begin(); i != by_hash.end();) {
+      i = i->second.expired() ? by_hash.erase(i) : std::next(i);
+    }
+    if (by_hash.empty() && sized->second.unhashed.expired()) {
+      sized = contents_by_size_.erase(sized);
+    } else {
+      ++sized;
+    }
+  }
 }
 
 const File* Source::FindFile(
     absl::string_view repository, absl::string_view path,
     absl::string_view root,
     std::function<std::unique_ptr<SourceBuffer>(const FileId&)> callback) {
-  auto file_id_view = std::make_tuple(repository, path, root);
-  const auto& i = file_map_.find(file_id_view);
-  if (i != file_map_.end()) {
-    return i->second;
+  if (const File* file = LookupFile(repository, path, root)) {
+    return file;
   }
-  FileId id;
-  id.repository_id = std::string(repository);
-  id.local_path = std::string(path);
-  id.root_path = std::string(root);
+  FileId id = MakeFileId(repository, path, root);
   auto new_sb = callback(id);
-  if (new_sb == nullptr) {
+  Location begin;
+  if (new_sb == nullptr ||
+      !ReserveLocations(id, new_sb->max_offset(), &begin)) {
     return nullptr;
   }
-  int to_allocate = new_sb->max_offset();
-  // Make sure that all files have at least one unique location.
-  if (to_allocate == 0) to_allocate = 1;
-  LOG(INFO) << "allocating " << to_allocate << " bytes of address space";
-  files_.emplace_back(
-      absl::make_unique<File>(id, std::move(*new_sb), max_location_));
-  max_location_ = max_location_.offset(to_allocate);
-  file_map_[file_id_view] = files_.back().get();
-  return files_.back().get();
+  return AddFile(
+      absl::make_unique<File>(id, ShareContents(std::move(new_sb)), begin));
+}
+
+const File* Source::FindLazyFile(
+    absl::string_view repository, absl::string_view path,
+    absl::string_view root, std::function<int(const FileId&)> size_callback,
+    FileLoader loader) {
+  if (const File* file = LookupFile(repository, path, root)) {
+    return file;
+  }
+  FileId id = MakeFileId(repository, path, root);
+  int size = size_callback(id);
+  Location begin;
+  if (size < 0 || !ReserveLocations(id, size, &begin)) {
+    return nullptr;
+  }
+  return AddFile(
+      absl::make_unique<File>(id, size, std::move(loader), begin, this));
+}
+
+void Source::ResolveLocations(absl::Span<const Location> locations,
+                              ResolvedLocation* out) const {
+  // Sort (location, index) pairs rather than indices so that comparisons
+  // don't have to chase pointers.
+  std::vector<std::pair<Location::Rep, uint32_t>> sorted(locations.size());
+  for (uint32_t i = 0; i < sorted.size(); ++i) {
+    sorted[i] = std::make_pair(locations[i].data(), i);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<int> offsets;
+  std::vector<SourceBuffer::LineCol> line_cols;
+  size_t file_index = 0;
+  for (size_t begin = 0; begin < sorted.size();) {
+    Location::Rep first = sorted[begin].first;
+    // Match `FindFile(Location)`: take the last file that starts at or before
+    // `first`, unless `first` is past the end of the last file.
+    while (file_index + 1 < files_.size() &&
+           files_[file_index + 1]->begin().data() <= first) {
+      ++file_index;
+    }
+    const File* file = nullptr;
+    if (first != 0 && !files_.empty() &&
+        files_[file_index]->begin().data() <= first &&
+        (file_index + 1 < files_.size() ||
+         first < files_[file_index]->end().data())) {
+      file = files_[file_index].get();
+    }
+    if (file == nullptr) {
+      out[sorted[begin].second] = ResolvedLocation();
+      ++begin;
+      continue;
+    }
+    // Gather the run of locations that fall in the same file.
+    Location::Rep limit = file_index + 1 < files_.size()
+                              ? files_[file_index + 1]->begin().data()
+                              : file->end().data();
+    size_t end = begin;
+    offsets.clear();
+    for (; end < sorted.size() && sorted[end].first < limit; ++end) {
+      offsets.push_back(sorted[end].first - file->begin().data());
+    }
+    line_cols.resize(offsets.size());
+    file->contents().LineColsForSortedOffsets(offsets, line_cols.data());
+    for (size_t i = begin; i < end; ++i) {
+      const auto& line_col = line_cols[i - begin];
+      out[sorted[i].second] = ResolvedLocation{
+          file, line_col.line, line_col.utf8_col, line_col.utf16_col};
+    }
+    begin = end;
+  }
+}
+
+void Source::EvictContents(size_t budget) {
+  std::vector<File*> resident;
+  // The number of lazily loaded files holding each buffer. A buffer with
+  // any other references is pinned (or belongs to an eagerly loaded file).
+  std::unordered_map<const SourceBuffer*, long> holders;
+  size_t resident_bytes = 0;
+  for (const auto& file : files_) {
+    if (file->is_lazy() && file->is_resident()) {
+      resident.push_back(file.get());
+      if (holders[file->contents_.get()]++ == 0) {
+        resident_bytes += file->contents_->content().size();
+      }
+    }
+  }
+  std::sort(resident.begin(), resident.end(), [](File* lhs, File* rhs) {
+    return lhs->last_use_ < rhs->last_use_;
+  });
+  for (File* file : resident) {
+    if (resident_bytes <= budget) {
+      break;
+    }
+    const SourceBuffer* contents = file->contents_.get();
+    long& count = holders[contents];
+    if (file->contents_.use_count() == count) {
+      size_t size = contents->content().size();
+      file->contents_.reset();
+      // Shared contents stay in memory until their last holder lets go.
+      if (--count == 0) {
+        resident_bytes -= size;
+      }
+    }
+  }
+  SweepContents();
+}
+
+size_t Source::lazy_resident_bytes() const {
+  std::unordered_set<const SourceBuffer*> seen;
+  size_t resident_bytes = 0;
+  for (const auto& file : files_) {
+    if (file->is_lazy() && file->is_resident() &&
+        seen.insert(file->contents_.get()).second) {
+      resident_bytes += file->contents_->content().size();
+    }
+  }
+  return resident_bytes;
+}
+
+size_t Source::shared_buffer_count() const {
+  std::unordered_set<const SourceBuffer*> seen;
+  for (const auto& file : files_) {
+    if (file->is_resident()) {
+      seen.insert(file->contents_.get());
+    }
+  }
+  return seen.size();
 }
 
 const File* Source::FindFile(Location loc) const {
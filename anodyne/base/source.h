@@ -17,14 +17,20 @@
 #ifndef ANODYNE_BASE_SOURCE_H__
 #define ANODYNE_BASE_SOURCE_H__
 
+#include "absl/hash/hash.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "anodyne/base/arena.h"
+#include "anodyne/base/arena_containers.h"
 #include "anodyne/base/source_buffer.h"
+#include "anodyne/base/symbol_table.h"
 
 #include <functional>
-#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace anodyne {
@@ -32,10 +38,20 @@ namespace anodyne {
 /// \brief A point in source text.
 ///
 /// Locations should be passed by value.
+///
+/// Each `Source` hands out one `Location` per byte of text it holds, so by
+/// default a `Source` can hold at most 4 GiB of text. Building with
+/// `--define anodyne_wide_locations=1` (which defines
+/// `ANODYNE_WIDE_LOCATIONS`) makes `Location`s 64 bits wide to lift this
+/// limit.
 class Location {
  public:
   /// The opaque type used for storing the `Location`'s value.
+#ifdef ANODYNE_WIDE_LOCATIONS
+  using Rep = uint64_t;
+#else
   using Rep = uint32_t;
+#endif
 
   /// \return an invalid location.
   Location() : data_(0) {}
@@ -72,6 +88,7 @@ class Location {
   /// Opaque data.
   Rep data_;
 };
+static_assert(sizeof(Location) <= 8, "Locations should stay small");
 
 class Source;
 
@@ -108,18 +125,42 @@ struct FileId {
   }
 };
 
+/// \brief Loads the contents of the file with the given id, or returns null
+/// on failure.
+using FileLoader = std::function<std::unique_ptr<SourceBuffer>(const FileId&)>;
+
 /// \brief A named buffer of source text.
+///
+/// A file's contents are either supplied up front or loaded by a
+/// `FileLoader` the first time they're needed (see `Source::FindLazyFile`).
+/// Lazily loaded contents may later be evicted by `Source::EvictContents`
+/// and loaded again; the file's `Location`s stay the same throughout.
 class File {
  public:
   File(const FileId& id, SourceBuffer&& contents, Location begin)
+      : id_(id),
+        contents_(std::make_shared<SourceBuffer>(std::move(contents))),
+        begin_(begin),
+        end_(begin.offset(contents_->max_offset())) {}
+  /// \param contents the file's contents, which may be shared with other
+  /// files.
+  File(const FileId& id, std::shared_ptr<const SourceBuffer> contents,
+       Location begin)
       : id_(id),
         contents_(std::move(contents)),
         begin_(begin),
-        end_(begin.offset(contents_.max_offset())) {}
+        end_(begin.offset(contents_->max_offset())) {}
+  /// \param size the size of the file's contents in bytes.
+  /// \param loader loads the contents; may be called more than once.
+  /// \param source counts uses of lazily loaded files, for eviction, and
+  /// shares loaded contents with identical files.
+  File(const FileId& id, int size, FileLoader loader, Location begin,
+       Source* source);
   File(const File&) = delete;
   File& operator=(const File&) = delete;
 
-  /// \brief Gets source text from [`begin`, `end`).
+  /// \brief Gets source text from [`begin`, `end`). The text lives as long
+  /// as the buffer returned by `contents`.
   absl::string_view Text(Location begin, Location end) const;
 
   /// \brief Gets source text from the given range.
@@ -144,16 +185,66 @@ class File {
     return static_cast<int>(loc.data() - begin_.data());
   }
 
-  /// \brief Return this file's underlying buffer.
-  const SourceBuffer& contents() const { return contents_; }
+  /// \brief Return this file's underlying buffer, loading it if necessary.
+  /// For lazily loaded files, the buffer is valid until the next call to
+  /// `Source::EvictContents`; use `PinContents` to hold on to it for longer.
+  /// If loading fails, this is an empty buffer.
+  const SourceBuffer& contents() const {
+    if (loader_ == nullptr) {
+      return *contents_;
+    }
+    *clock_ += 1;
+    last_use_ = *clock_;
+    return contents_ != nullptr ? *contents_ : Load();
+  }
+
+  /// \brief Returns this file's underlying buffer, loading it if necessary.
+  /// The buffer won't be evicted while the returned pointer is alive.
+  std::shared_ptr<const SourceBuffer> PinContents() const {
+    contents();
+    return contents_;
+  }
+
+  /// \return whether this file's contents are loaded lazily.
+  bool is_lazy() const { return loader_ != nullptr; }
+  /// \return whether this file's contents are in memory.
+  bool is_resident() const { return contents_ != nullptr; }
 
  private:
+  friend class Source;
+  /// \brief Loads `contents_` with `loader_`.
+  /// \return the new contents, or an empty buffer on failure.
+  const SourceBuffer& Load() const;
+  /// \return a shared empty buffer.
+  static std::shared_ptr<const SourceBuffer> EmptyContents();
+
   FileId id_;
-  SourceBuffer contents_;
+  /// The file's contents, or null if they haven't been loaded.
+  mutable std::shared_ptr<const SourceBuffer> contents_;
+  /// Loads `contents_` on demand, or null if the contents were supplied.
+  FileLoader loader_;
+  /// The `Source` that owns this file, if its contents are loaded lazily.
+  Source* source_ = nullptr;
+  /// Counts uses of lazily loaded files in `source_`.
+  uint64_t* clock_ = nullptr;
+  /// The value of `*clock_` when the contents were last used.
+  mutable uint64_t last_use_ = 0;
   Location begin_;
   Location end_;
 };
 
+/// \brief A `Location` resolved to a file, line and column.
+struct ResolvedLocation {
+  /// The file containing the `Location`, or null if there isn't one.
+  const File* file = nullptr;
+  /// The 0-based line, or -1 if the `Location` couldn't be resolved.
+  int line = -1;
+  /// The 0-based column in UTF-8 code units, or -1.
+  int utf8_col = -1;
+  /// The 0-based column in UTF-16 code units, or -1.
+  int utf16_col = -1;
+};
+
 /// \brief Manages source text and mapping `Locations` to and from files.
 class Source {
  public:
@@ -162,14 +253,42 @@ class Source {
   Source& operator=(const Source&) = delete;
   /// \return The `File` with the given repository, path, and root; or null.
   /// If a `callback` is provided, its result will be stored for that triple.
-  /// The `File` is owned by this `Source`.
+  /// The `File` is owned by this `Source`. Also returns null if the file
+  /// doesn't fit in the remaining `Location` space.
   const File* FindFile(
       absl::string_view repository, absl::string_view path,
       absl::string_view root,
       std::function<std::unique_ptr<SourceBuffer>(const FileId&)> callback);
+  /// \brief Like `FindFile`, but defers loading a new file's contents until
+  /// `File::contents` is first called.
+  /// \param size_callback returns the size of the file in bytes (for
+  /// example, from `stat`), or a negative number if there is no such file.
+  /// \param loader loads the file's contents, which must be `size` bytes
+  /// long. It is called again if the contents are evicted and then used.
+  const File* FindLazyFile(absl::string_view repository,
+                           absl::string_view path, absl::string_view root,
+                           std::function<int(const FileId&)> size_callback,
+                           FileLoader loader);
   /// \return The `File` in which `loc` is stored, or null. The `File` is owned
   /// by this `Source`.
   const File* FindFile(Location loc) const;
+  /// \brief Resolves each of `locations` to a file, line and column, storing
+  /// the results (in the same order) in `out`.
+  ///
+  /// This is much faster than calling `FindFile` and `Utf8LineColForOffset`
+  /// for each `Location`: the `Location`s are sorted, and then the files and
+  /// their line tables are swept once.
+  void ResolveLocations(absl::Span<const Location> locations,
+                        ResolvedLocation* out) const;
+  /// \brief Evicts the contents of the least recently used lazily loaded
+  /// files until at most `budget` bytes of such contents remain in memory.
+  /// Contents that are pinned (see `File::PinContents`) aren't evicted.
+  void EvictContents(size_t budget);
+  /// \return the number of bytes of lazily loaded contents in memory.
+  /// Contents shared by several files are counted once.
+  size_t lazy_resident_bytes() const;
+  /// \return the number of distinct buffers of file contents in memory.
+  size_t shared_buffer_count() const;
   /// \return a location suitable for builtin objects referenced by real objects
   Location builtin_location(Location in) const { return Location{}; }
   /// \return a range suitable for builtin objects referenced by real objects
@@ -178,11 +297,65 @@ class Source {
   }
 
  private:
+  /// \brief Looks up an existing file.
+  /// \return the file, or null if there isn't one.
+  const File* LookupFile(absl::string_view repository, absl::string_view path,
+                         absl::string_view root);
+  /// \brief Reserves `size` `Location`s for the file with id `id`.
+  /// \return false if there isn't enough space left.
+  bool ReserveLocations(const FileId& id, int size, Location* begin);
+  /// \brief Takes ownership of `file` and indexes it.
+  const File* AddFile(std::unique_ptr<File> file);
+  /// \return `buffer`, or an identical buffer already in memory. Buffers
+  /// with source maps aren't shared.
+  std::shared_ptr<const SourceBuffer> ShareContents(
+      std::unique_ptr<SourceBuffer> buffer);
+  /// \brief Forgets buffers in `contents_by_size_` that are no longer in
+  /// memory.
+  void SweepContents();
+  friend class File;
+  /// \brief Identifies a file by the interned parts of its `FileId`.
+  struct FileKey {
+    Symbol repository;
+    Symbol path;
+    Symbol root;
+    bool operator==(const FileKey& o) const {
+      return repository == o.repository && path == o.path && root == o.root;
+    }
+    template <typename H>
+    friend H AbslHashValue(H h, const FileKey& key) {
+      return H::combine(std::move(h), key.repository, key.path, key.root);
+    }
+  };
   std::vector<std::unique_ptr<File>> files_;
-  std::map<std::tuple<absl::string_view, absl::string_view, absl::string_view>,
-           const File*>
-      file_map_;
+  /// \return options for `file_id_symbols_`, which never needs the
+  /// well-known (JavaScript) symbols.
+  static SymbolTable::Options FileIdSymbolOptions() {
+    SymbolTable::Options options;
+    options.well_known_symbols = false;
+    return options;
+  }
+  /// Interns the parts of `FileId`s; owns the text of `file_map_`'s keys.
+  SymbolTable file_id_symbols_{FileIdSymbolOptions()};
+  /// Holds `file_map_`.
+  Arena file_map_arena_;
+  ArenaHashMap<FileKey, const File*, absl::Hash<FileKey>> file_map_{
+      &file_map_arena_};
   Location max_location_;
+  /// Counts uses of lazily loaded files.
+  uint64_t use_clock_ = 0;
+  /// \brief Buffers of file contents that are all the same size.
+  struct SizedContents {
+    /// The only buffer of this size. It isn't hashed until another buffer
+    /// of the same size turns up.
+    std::weak_ptr<const SourceBuffer> unhashed;
+    /// Buffers of this size, keyed by the hash of their contents.
+    std::unordered_multimap<size_t, std::weak_ptr<const SourceBuffer>> by_hash;
+  };
+  /// Maps content sizes to the buffers holding contents of that size, so
+  /// that identical files (common in vendored dependencies) share one
+  /// buffer and line table.
+  std::unordered_map<size_t, SizedContents> contents_by_size_;
 };
 }  // namespace anodyne
 
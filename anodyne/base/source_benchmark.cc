@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks mapping `Location`s back to files and lines.
+//
+// Run once normally and once with `--define anodyne_wide_locations=1` to
+// compare 32- and 64-bit `Location`s.
+
+#include "anodyne/base/source.h"
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace anodyne {
+namespace {
+
+/// \brief A `Source` full of files, and ranges in them to look up.
+struct Corpus {
+  Source source;
+  std::vector<Range> ranges;
+};
+
+/// \return the path of the `index`th file in a corpus. Real paths are long
+/// and share long prefixes, which makes them slow to compare.
+std::string PathFor(int index) {
+  return absl::StrCat("node_modules/@scope/package", index / 64,
+                      "/lib/src/components/module", index % 64, ".js");
+}
+
+/// \return about 8 KiB of source text, distinct for each `index`.
+std::string ContentFor(int index) {
+  std::string content = absl::StrCat("// module ", index, "\n");
+  for (int line = 0; line < 200; ++line) {
+    content.append(std::string(line % 80, ' ')).append("x = y;\n");
+  }
+  return content;
+}
+
+/// \return a corpus of `file_count` files of about 8 KiB each. Every file
+/// has different contents, so none of them share a `SourceBuffer`.
+std::unique_ptr<Corpus> MakeCorpus(int file_count) {
+  auto corpus = absl::make_unique<Corpus>();
+  std::mt19937 random(42);
+  std::string content = ContentFor(0);
+  std::vector<const File*> files;
+  for (int i = 0; i < file_count; ++i) {
+    files.push_back(corpus->source.FindFile(
+        "repo", PathFor(i), "", [&](const FileId& id) {
+          return absl::make_unique<SourceBuffer>(ContentFor(i), SourceMap{});
+        }));
+  }
+  std::uniform_int_distribution<int> file(0, file_count - 1);
+  std::uniform_int_distribution<int> offset(0, content.size() - 10);
+  for (int i = 0; i < 4096; ++i) {
+    Location begin = files[file(random)]->begin().offset(offset(random));
+    corpus->ranges.push_back(Range{begin, begin.offset(8)});
+  }
+  return corpus;
+}
+
+void BM_RangeToString(benchmark::State& state) {
+  auto corpus = MakeCorpus(state.range(0));
+  size_t i = 0;
+  for (auto _ : state) {
+    const Range& range = corpus->ranges[i++ % corpus->ranges.size()];
+    benchmark::DoNotOptimize(range.ToString(corpus->source));
+  }
+  state.SetLabel(sizeof(Location) == 8 ? "wide" : "narrow");
+}
+BENCHMARK(BM_RangeToString)->Arg(16)->Arg(4096);
+
+void BM_FindFile(benchmark::State& state) {
+  auto corpus = MakeCorpus(state.range(0));
+  size_t i = 0;
+  for (auto _ : state) {
+    const Range& range = corpus->ranges[i++ % corpus->ranges.size()];
+    benchmark::DoNotOptimize(corpus->source.FindFile(range.begin));
+  }
+  state.SetLabel(sizeof(Location) == 8 ? "wide" : "narrow");
+}
+BENCHMARK(BM_FindFile)->Arg(16)->Arg(4096);
+
+/// \return the ends of every range in `corpus`.
+std::vector<Location> Endpoints(const Corpus& corpus) {
+  std::vector<Location> locations;
+  for (const auto& range : corpus.ranges) {
+    locations.push_back(range.begin);
+    locations.push_back(range.end);
+  }
+  return locations;
+}
+
+/// Resolving locations one at a time.
+void BM_ResolveEachLocation(benchmark::State& state) {
+  auto corpus = MakeCorpus(state.range(0));
+  auto locations = Endpoints(*corpus);
+  for (auto _ : state) {
+    for (Location location : locations) {
+      const File* file = corpus->source.FindFile(location);
+      benchmark::DoNotOptimize(file->contents().Utf8LineColForOffset(
+          location.data() - file->begin().data()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * locations.size());
+}
+BENCHMARK(BM_ResolveEachLocation)->Arg(16)->Arg(4096);
+
+/// Resolving locations with `ResolveLocations`, which also finds UTF-16
+/// columns.
+void BM_ResolveLocations(benchmark::State& state) {
+  auto corpus = MakeCorpus(state.range(0));
+  auto locations = Endpoints(*corpus);
+  std::vector<ResolvedLocation> resolved(locations.size());
+  for (auto _ : state) {
+    corpus->source.ResolveLocations(locations, resolved.data());
+    benchmark::DoNotOptimize(resolved.data());
+  }
+  state.SetItemsProcessed(state.iterations() * locations.size());
+}
+BENCHMARK(BM_ResolveLocations)->Arg(16)->Arg(4096);
+
+/// Loading 16 files of 1 MiB each into a fresh `Source`. The files have
+/// different sizes if `state.range(0)` is 0, so none are hashed; the same
+/// size but different contents if it is 1, so all are hashed; and the same
+/// contents if it is 2, so all share one buffer.
+void BM_LoadFiles(benchmark::State& state) {
+  constexpr int kFileCount = 16;
+  std::vector<std::string> contents;
+  for (int i = 0; i < kFileCount; ++i) {
+    std::string content;
+    while (content.size() < (1 << 20)) {
+      content.append("  const x = foo(bar, baz);  // comment\n");
+    }
+    if (state.range(0) == 0) {
+      content.append(i, ' ');
+    } else if (state.range(0) == 1) {
+      content[i] = '!';
+    }
+    contents.push_back(std::move(content));
+  }
+  for (auto _ : state) {
+    Source source;
+    for (int i = 0; i < kFileCount; ++i) {
+      benchmark::DoNotOptimize(
+          source.FindFile("repo", PathFor(i), "", [&](const FileId& id) {
+            return absl::make_unique<SourceBuffer>(
+                absl::string_view(contents[i]), SourceMap{});
+          }));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kFileCount *
+                          contents[0].size());
+}
+BENCHMARK(BM_LoadFiles)->Arg(0)->Arg(1)->Arg(2);
+
+void BM_FindFileById(benchmark::State& state) {
+  auto corpus = MakeCorpus(state.range(0));
+  std::vector<std::string> paths;
+  for (int i = 0; i < state.range(0); ++i) {
+    paths.push_back(PathFor(i));
+  }
+  auto missing = [](const FileId& id) { return nullptr; };
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& path = paths[i++ % paths.size()];
+    benchmark::DoNotOptimize(
+        corpus->source.FindFile("repo", path, "", missing));
+  }
+}
+BENCHMARK(BM_FindFileById)->Arg(16)->Arg(4096);
+
+}  // anonymous namespace
+}  // namespace anodyne
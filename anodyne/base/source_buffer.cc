@@ -19,6 +19,11 @@
 #include "glog/logging.h"
 
 #include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 namespace anodyne {
 namespace {
@@ -89,82 +94,439 @@ int32_t ReadUtf8(const unsigned char* buffer, int pos, int bound,
 int Utf16CodeUnitsFor(int32_t code_point) {
   return code_point >= 0x10000 ? 2 : 1;
 }
+
+/// The spacing in bytes of `SourceBuffer`'s UTF-16 checkpoints.
+constexpr int kCheckpointInterval = 256;
+
+/// \return where to put the first checkpoint after `offset`.
+int NextCheckpointAfter(int offset) {
+  return offset - offset % kCheckpointInterval + kCheckpointInterval;
+}
+
+/// \brief Builds the line tables and UTF-16 checkpoints of a `SourceBuffer`.
+///
+/// Every newline byte ends a line, since `ReadUtf8` never consumes one as
+/// part of a multibyte sequence. The tables hold the offset one past the
+/// start of each line (after the newline) in UTF-8 and UTF-16 units.
+class LineScanner {
+ public:
+  LineScanner(const std::string& content, std::vector<int>* line_to_offset,
+              std::vector<int>* line_to_utf16_offset,
+              std::vector<int>* checkpoint_offsets,
+              std::vector<int>* checkpoint_utf16_offsets)
+      : data_(reinterpret_cast<const unsigned char*>(content.data())),
+        size_(content.size()),
+        line_to_offset_(line_to_offset),
+        line_to_utf16_offset_(line_to_utf16_offset),
+        checkpoint_offsets_(checkpoint_offsets),
+        checkpoint_utf16_offsets_(checkpoint_utf16_offsets) {}
+
+  /// \brief Scans the code point at `pos_`.
+  void ScanCodePoint() {
+    if (data_[pos_] >= 0x80 && ascii()) {
+      NoteNonAscii(pos_);
+    }
+    int32_t c = ReadUtf8(data_, pos_, size_, &pos_);
+    utf16_offset_ += Utf16CodeUnitsFor(c);
+    if (c == '\n') {
+      line_to_offset_->push_back(pos_ + 1);
+      line_to_utf16_offset_->push_back(utf16_offset_ + 1);
+    }
+    MaybeCheckpoint();
+  }
+
+  /// \brief Scans the code point at `pos_`, which is out of the ordinary.
+  /// This is kept out of line so that `ScanBlocks` stays small.
+  __attribute__((noinline)) void ScanMalformedCodePoint() { ScanCodePoint(); }
+
+  /// \brief Scans everything left, one code point at a time.
+  void ScanRest() {
+    while (pos_ < size_) {
+      ScanCodePoint();
+    }
+  }
+
+#if defined(__x86_64__)
+  /// \brief Describes a block of `kWidth` bytes. Bit `i` of each mask is
+  /// about byte `i`.
+  struct Block {
+    /// Bytes >= 0x80.
+    uint64_t non_ascii;
+    /// Newline bytes.
+    uint64_t newline;
+    /// Bytes that start sequences of at least two (>= 0xC0), at least three
+    /// (>= 0xE0) or four (>= 0xF0) bytes.
+    uint64_t lead2;
+    uint64_t lead3;
+    uint64_t lead4;
+  };
+
+  /// \brief Scans whole blocks while they're well-formed UTF-8, then falls
+  /// back to single code points until blocks are well-formed again.
+  /// `Isa::Classify` describes the block at a pointer.
+  template <typename Isa>
+  __attribute__((always_inline)) inline void ScanBlocks() {
+    constexpr int kWidth = Isa::kWidth;
+    // Work on locals so that they stay in registers across `push_back`.
+    int pos = pos_;
+    int utf16_offset = utf16_offset_;
+    std::vector<int>* line_to_offset = line_to_offset_;
+    std::vector<int>* line_to_utf16_offset = line_to_utf16_offset_;
+    while (size_ - pos >= kWidth) {
+      Block block = Isa::Classify(data_ + pos);
+      if (block.non_ascii == 0) {
+        // One UTF-16 unit per byte.
+        for (uint64_t lines = block.newline; lines != 0; lines &= lines - 1) {
+          int i = __builtin_ctzll(lines);
+          line_to_offset->push_back(pos + i + 2);
+          line_to_utf16_offset->push_back(utf16_offset + i + 2);
+        }
+        pos += kWidth;
+        utf16_offset += kWidth;
+        if (pos >= next_checkpoint_) {
+          Checkpoint(pos, utf16_offset);
+        }
+        continue;
+      }
+      if (ascii()) {
+        NoteNonAscii(pos + __builtin_ctzll(block.non_ascii));
+      }
+      // Stop before a sequence that runs off the end of the block. This
+      // leaves at least `kWidth - 3` bytes.
+      uint64_t cut_leads = (block.lead2 & (1ull << (kWidth - 1))) |
+                           (block.lead3 & (1ull << (kWidth - 2))) |
+                           (block.lead4 & (1ull << (kWidth - 3)));
+      int cut = cut_leads == 0 ? kWidth : __builtin_ctzll(cut_leads);
+      uint64_t in_cut = ~0ull >> (64 - cut);
+      uint64_t lead2 = block.lead2 & in_cut;
+      uint64_t lead3 = block.lead3 & in_cut;
+      uint64_t lead4 = block.lead4 & in_cut;
+      // Well-formed blocks have continuation bytes exactly where their
+      // leading bytes say. `ReadUtf8` decodes these to one code point per
+      // non-continuation byte, two UTF-16 units for each four-byte sequence.
+      uint64_t continuation = block.non_ascii & ~block.lead2 & in_cut;
+      if (((lead2 << 1) | (lead3 << 2) | (lead4 << 3)) != continuation) {
+        pos_ = pos;
+        utf16_offset_ = utf16_offset;
+        ScanMalformedCodePoint();
+        pos = pos_;
+        utf16_offset = utf16_offset_;
+        continue;
+      }
+      uint64_t units = (in_cut & ~continuation);
+      for (uint64_t lines = block.newline & in_cut; lines != 0;
+           lines &= lines - 1) {
+        int i = __builtin_ctzll(lines);
+        uint64_t through = ~0ull >> (63 - i);
+        line_to_offset->push_back(pos + i + 2);
+        line_to_utf16_offset->push_back(
+            utf16_offset + __builtin_popcountll(units & through) +
+            __builtin_popcountll(lead4 & through) + 1);
+      }
+      pos += cut;
+      utf16_offset +=
+          __builtin_popcountll(units) + __builtin_popcountll(lead4);
+      if (pos >= next_checkpoint_) {
+        Checkpoint(pos, utf16_offset);
+      }
+    }
+    pos_ = pos;
+    utf16_offset_ = utf16_offset;
+  }
+#endif
+
+  /// \return whether every byte scanned so far was ASCII.
+  bool ascii() const { return ascii_prefix_ < 0; }
+  /// \return the offset of the first non-ASCII byte, or the size of the
+  /// content if there isn't one.
+  int ascii_prefix() const { return ascii() ? size_ : ascii_prefix_; }
+  /// \return the offset of the next code point to scan.
+  int offset() const { return pos_; }
+  /// \return the number of UTF-16 units scanned so far.
+  int utf16_offset() const { return utf16_offset_; }
+
+ private:
+  /// \brief Records that the first non-ASCII byte is at `offset`. Offsets
+  /// before it are their own UTF-16 offsets, so checkpoints start after it.
+  __attribute__((noinline)) void NoteNonAscii(int offset) {
+    ascii_prefix_ = offset;
+    next_checkpoint_ = NextCheckpointAfter(offset);
+  }
+  /// \brief Adds a checkpoint at `pos_` if it's time for one.
+  void MaybeCheckpoint() {
+    if (pos_ >= next_checkpoint_) {
+      Checkpoint(pos_, utf16_offset_);
+    }
+  }
+  /// \brief Adds a checkpoint for the code point at `offset`, whose UTF-16
+  /// offset is `utf16_offset`.
+  __attribute__((noinline)) void Checkpoint(int offset, int utf16_offset) {
+    checkpoint_offsets_->push_back(offset);
+    checkpoint_utf16_offsets_->push_back(utf16_offset);
+    next_checkpoint_ = NextCheckpointAfter(offset);
+  }
+
+  const unsigned char* data_;
+  int size_;
+  std::vector<int>* line_to_offset_;
+  std::vector<int>* line_to_utf16_offset_;
+  std::vector<int>* checkpoint_offsets_;
+  std::vector<int>* checkpoint_utf16_offsets_;
+  /// The offset of the next code point to scan.
+  int pos_ = 0;
+  /// The UTF-16 offset of `pos_`.
+  int utf16_offset_ = 0;
+  /// The offset of the first non-ASCII byte, or -1 if there hasn't been one.
+  int ascii_prefix_ = -1;
+  /// Where the next checkpoint goes.
+  int next_checkpoint_ = std::numeric_limits<int>::max();
+};
+
+#if defined(__x86_64__)
+/// \return the bytes of `v` that are at least `b`.
+__attribute__((always_inline)) inline uint64_t AtLeast(__m128i v,
+                                                       unsigned char b) {
+  return static_cast<uint16_t>(_mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(b)), v)));
+}
+
+/// \brief Classifies blocks with SSE2, which every x86-64 processor has.
+struct Sse2 {
+  static constexpr int kWidth = 16;
+  __attribute__((always_inline)) static LineScanner::Block Classify(
+      const unsigned char* data) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    LineScanner::Block block;
+    block.non_ascii = static_cast<uint16_t>(_mm_movemask_epi8(v));
+    block.newline = static_cast<uint16_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+    if (block.non_ascii != 0) {
+      block.lead2 = AtLeast(v, 0xC0);
+      block.lead3 = AtLeast(v, 0xE0);
+      block.lead4 = AtLeast(v, 0xF0);
+    }
+    return block;
+  }
+};
+
+/// \return the bytes of `v` that are at least `b`.
+__attribute__((target("avx2"), always_inline)) inline uint64_t AtLeast(
+    __m256i v, unsigned char b) {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(b)), v)));
+}
+
+/// \brief Classifies blocks with AVX2.
+struct Avx2 {
+  static constexpr int kWidth = 32;
+  __attribute__((target("avx2"))) static LineScanner::Block Classify(
+      const unsigned char* data) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    LineScanner::Block block;
+    block.non_ascii = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    block.newline = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+    if (block.non_ascii != 0) {
+      block.lead2 = AtLeast(v, 0xC0);
+      block.lead3 = AtLeast(v, 0xE0);
+      block.lead4 = AtLeast(v, 0xF0);
+    }
+    return block;
+  }
+};
+
+// Flattening inlines `Classify` (and everything else) into this function,
+// which GCC won't otherwise do across the change of target.
+__attribute__((target("avx2"), flatten)) void ScanBlocksAvx2(
+    LineScanner* scanner) {
+  scanner->ScanBlocks<Avx2>();
+}
+#endif
 }  // anonymous namespace
 
+void SourceBuffer::ScanLines() {
+  LineScanner scanner(content_, &line_to_offset_, &line_to_utf16_offset_,
+                      &checkpoint_offsets_, &checkpoint_utf16_offsets_);
+  const auto& segments = source_map_.segments();
+  if (!segments.empty()) {
+    // Match up segments one code point at a time.
+    int segment_index = 0;
+    const SourceMapSegment* segment = &segments[segment_index];
+    int utf16_col = 0;
+    while (scanner.offset() < content_.size()) {
+      int line_count = line_to_offset_.size();
+      int utf16_offset = scanner.utf16_offset();
+      scanner.ScanCodePoint();
+      int utf8_offset = scanner.offset();
+      utf16_col = line_to_offset_.size() == line_count
+                      ? utf16_col + scanner.utf16_offset() - utf16_offset
+                      : 0;
+      while (segment != nullptr &&
+             (segment->generated_line < line_to_offset_.size() - 1 ||
+              segment->generated_col < utf16_col)) {
+        ++segment_index;
+        segment = segment_index >= segments.size() ? nullptr
+                                                   : &segments[segment_index];
+      }
+      if (segment != nullptr &&
+          segment->generated_line == line_to_offset_.size() - 1 &&
+          segment->generated_col == utf16_col) {
+        segment_offsets_.push_back(utf8_offset);
+        segment_indices_.push_back(segment_index);
+      }
+    }
+    segment_offsets_.shrink_to_fit();
+    segment_indices_.shrink_to_fit();
+  }
+#if defined(__x86_64__)
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    ScanBlocksAvx2(&scanner);
+  }
+  scanner.ScanBlocks<Sse2>();
+#endif
+  scanner.ScanRest();
+  ascii_ = scanner.ascii();
+  ascii_prefix_ = scanner.ascii_prefix();
+  utf16_size_ = scanner.utf16_offset();
+}
+
 SourceBuffer::SourceBuffer(std::string&& content, SourceMap&& source_map)
-    : content_(content), source_map_(source_map) {
+    : content_(std::move(content)), source_map_(std::move(source_map)) {
   // TODO: Right now we assume that the incoming file is in UTF-8 with Unix
   // line endings. If this is not the case, we should convert it.
-  int segment_index = 0;
-  const auto& segments = source_map_.segments();
-  const SourceMapSegment* segment =
-      segment_index >= segments.size() ? nullptr : &segments[segment_index];
-  int utf16_col = 0;
   line_to_offset_.push_back(0);
   line_to_utf16_offset_.push_back(0);
+  max_offset_ = content_.size();
+  ScanLines();
+}
+
+int SourceBuffer::Utf16OffsetForOffset(int offset) const {
+  if (offset < 0 || offset > max_offset_) {
+    return -1;
+  }
+  if (offset <= ascii_prefix_) {
+    return offset;
+  }
+  int utf8_offset = ascii_prefix_;
+  int utf16_offset = ascii_prefix_;
+  auto i = std::upper_bound(checkpoint_offsets_.begin(),
+                            checkpoint_offsets_.end(), offset);
+  if (i != checkpoint_offsets_.begin()) {
+    --i;
+    utf8_offset = *i;
+    utf16_offset = checkpoint_utf16_offsets_[i - checkpoint_offsets_.begin()];
+  }
   const unsigned char* data =
       reinterpret_cast<const unsigned char*>(content_.data());
-  int utf16_offset = 0;
-  for (int utf8_offset = 0; utf8_offset < content_.size();) {
-    int32_t c = ReadUtf8(data, utf8_offset, content_.size(), &utf8_offset);
-    int utf16_size = Utf16CodeUnitsFor(c);
-    utf16_offset += utf16_size;
-    utf16_col += utf16_size;
-    if (c == '\n') {
-      line_to_offset_.push_back(utf8_offset + 1);
-      line_to_utf16_offset_.push_back(utf16_offset + 1);
-      utf16_col = 0;
+  while (utf8_offset < offset) {
+    utf16_offset += Utf16CodeUnitsFor(
+        ReadUtf8(data, utf8_offset, content_.size(), &utf8_offset));
+  }
+  return utf16_offset;
+}
+
+int SourceBuffer::OffsetForUtf16OffsetFrom(int from, int from_utf16,
+                                           int utf16_offset) const {
+  if (utf16_offset <= ascii_prefix_) {
+    return std::max(from, utf16_offset);
+  }
+  int utf8_offset = from;
+  // Every code point before the checkpoints we skip to has a lower UTF-16
+  // offset than theirs.
+  if (from < ascii_prefix_) {
+    utf8_offset = ascii_prefix_;
+    from_utf16 = ascii_prefix_;
+  }
+  auto i = std::upper_bound(checkpoint_utf16_offsets_.begin(),
+                            checkpoint_utf16_offsets_.end(), utf16_offset);
+  if (i != checkpoint_utf16_offsets_.begin()) {
+    --i;
+    int checkpoint = checkpoint_offsets_[i - checkpoint_utf16_offsets_.begin()];
+    if (checkpoint > utf8_offset) {
+      utf8_offset = checkpoint;
+      from_utf16 = *i;
     }
-    while (segment != nullptr &&
-           (segment->generated_line < line_to_offset_.size() - 1 ||
-            segment->generated_col < utf16_col)) {
-      ++segment_index;
-      segment =
-          segment_index >= segments.size() ? nullptr : &segments[segment_index];
+  }
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(content_.data());
+  while (utf8_offset < content_.size() && from_utf16 < utf16_offset) {
+    from_utf16 += Utf16CodeUnitsFor(
+        ReadUtf8(data, utf8_offset, content_.size(), &utf8_offset));
+  }
+  return utf8_offset;
+}
+
+int SourceBuffer::AlignLineStart(int line, int end, int col,
+                                 int* utf16_col) const {
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(content_.data());
+  int utf8_offset = line_to_offset_[line];
+  *utf16_col = 0;
+  // Lines after the first start one byte in (see `line_to_offset_`), which
+  // may be in the middle of a code point. Decode from there until we get
+  // back in step with the code points that the checkpoints count.
+  int boundary = line == 0 ? utf8_offset : utf8_offset - 1;
+  while (boundary != utf8_offset) {
+    if (boundary < utf8_offset) {
+      ReadUtf8(data, boundary, content_.size(), &boundary);
+      continue;
     }
-    if (segment != nullptr &&
-        segment->generated_line == line_to_offset_.size() - 1 &&
-        segment->generated_col == utf16_col) {
-      offset_to_segment_[utf8_offset] = segment_index;
+    if (utf8_offset >= end || *utf16_col >= col) {
+      break;
     }
+    *utf16_col += Utf16CodeUnitsFor(
+        ReadUtf8(data, utf8_offset, content_.size(), &utf8_offset));
   }
-  max_offset_ = content_.size();
+  return utf8_offset;
 }
 
 int SourceBuffer::OffsetForUtf16LineCol(int line, int col) const {
   if (line < 0 || line >= line_to_offset_.size()) {
     return -1;
   }
-  const unsigned char* data =
-      reinterpret_cast<const unsigned char*>(content_.data());
-  int utf8_offset = line_to_offset_[line];
-  for (int utf16_col = 0; utf8_offset < content_.size() && utf16_col < col;) {
-    int32_t c = ReadUtf8(data, utf8_offset, content_.size(), &utf8_offset);
-    utf16_col += Utf16CodeUnitsFor(c);
+  int utf16_col;
+  int utf8_offset = AlignLineStart(line, content_.size(), col, &utf16_col);
+  if (utf8_offset >= content_.size() || utf16_col >= col) {
+    return utf8_offset;
   }
-  return utf8_offset;
+  int from_utf16 = Utf16OffsetForOffset(utf8_offset);
+  if (col - utf16_col > utf16_size_ - from_utf16) {
+    return content_.size();
+  }
+  return OffsetForUtf16OffsetFrom(utf8_offset, from_utf16,
+                                  from_utf16 + col - utf16_col);
 }
 
 int SourceBuffer::OffsetForUtf16Offset(int offset) const {
-  if (line_to_utf16_offset_.empty() || line_to_offset_.empty()) return -1;
-  auto i = std::lower_bound(line_to_utf16_offset_.begin(),
-                            line_to_utf16_offset_.end(), offset);
-  // No offset tables or offset is on the last line in the table.
-  if (i == line_to_utf16_offset_.end()) {
-    return OffsetForUtf16LineCol(line_to_utf16_offset_.size() - 1,
-                                 offset - line_to_utf16_offset_.back());
+  if (offset < 0 || offset > utf16_size_) {
+    return -1;
   }
-  if (*i == offset) {
-    return line_to_offset_[*i];
+  return OffsetForUtf16OffsetFrom(0, 0, offset);
+}
+
+std::pair<int, int> SourceBuffer::Utf16LineColForOffset(int offset) const {
+  auto line_col = Utf8LineColForOffset(offset);
+  if (line_col.first < 0 || ascii_) {
+    return line_col;
   }
-  int line = line_to_utf16_offset_.end() - i - 1;
-  if (line < 0) {
-    // We always insert a mapping from line 0 to offset 0, so this should not
-    // be possible.
-    LOG(ERROR) << "invariant broken: negative current line";
-    return -1;
+  int utf16_col;
+  int utf8_offset =
+      AlignLineStart(line_col.first, offset,
+                     std::numeric_limits<int>::max(), &utf16_col);
+  if (offset - utf8_offset > kCheckpointInterval) {
+    utf16_col +=
+        Utf16OffsetForOffset(offset) - Utf16OffsetForOffset(utf8_offset);
+    return std::make_pair(line_col.first, utf16_col);
   }
-  return OffsetForUtf16LineCol(line, offset - line_to_utf16_offset_[line]);
+  // Short lines are quicker to decode directly.
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(content_.data());
+  while (utf8_offset < offset) {
+    utf16_col += Utf16CodeUnitsFor(
+        ReadUtf8(data, utf8_offset, content_.size(), &utf8_offset));
+  }
+  return std::make_pair(line_col.first, utf16_col);
 }
 
 std::pair<int, int> SourceBuffer::Utf8LineColForOffset(int offset) const {
@@ -183,10 +545,71 @@ std::pair<int, int> SourceBuffer::Utf8LineColForOffset(int offset) const {
   return std::make_pair(i - line_to_offset_.begin() - 1, offset - *(i - 1));
 }
 
+void SourceBuffer::LineColsForSortedOffsets(absl::Span<const int> offsets,
+                                            LineCol* out) const {
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(content_.data());
+  int bound = content_.size();
+  size_t line = 0;
+  // The UTF-16 column of `utf8_offset` on `line`; both only move forward.
+  int utf8_offset = line_to_offset_.empty() ? 0 : line_to_offset_[0];
+  int utf16_col = 0;
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    int offset = offsets[i];
+    if (offset < 0 || offset > max_offset_ || line_to_offset_.empty()) {
+      out[i] = LineCol{-1, -1, -1};
+      continue;
+    }
+    if (line + 1 < line_to_offset_.size() &&
+        line_to_offset_[line + 1] <= offset) {
+      do {
+        ++line;
+      } while (line + 1 < line_to_offset_.size() &&
+               line_to_offset_[line + 1] <= offset);
+      utf8_offset = line_to_offset_[line];
+      utf16_col = 0;
+    }
+    int utf8_col = offset - line_to_offset_[line];
+    if (ascii_) {
+      out[i] = LineCol{static_cast<int>(line), utf8_col, utf8_col};
+      continue;
+    }
+    while (utf8_offset < offset && utf8_offset < bound) {
+      if (data[utf8_offset] < 0x80) {
+        ++utf8_offset;
+        ++utf16_col;
+      } else {
+        utf16_col += Utf16CodeUnitsFor(
+            ReadUtf8(data, utf8_offset, bound, &utf8_offset));
+      }
+    }
+    out[i] = LineCol{static_cast<int>(line), utf8_col, utf16_col};
+  }
+}
+
+int SourceBuffer::SegmentIndexAtOrBefore(int offset) const {
+  auto i = std::upper_bound(segment_offsets_.begin(), segment_offsets_.end(),
+                            offset);
+  return static_cast<int>(i - segment_offsets_.begin()) - 1;
+}
+
 const SourceMapSegment* SourceBuffer::SegmentForOffset(int offset) const {
-  auto i = offset_to_segment_.find(offset);
-  return (i != offset_to_segment_.end()) ? &source_map_.segments()[i->second]
-                                         : nullptr;
+  int i = SegmentIndexAtOrBefore(offset);
+  return (i >= 0 && segment_offsets_[i] == offset)
+             ? &source_map_.segments()[segment_indices_[i]]
+             : nullptr;
+}
+
+const SourceMapSegment* SourceBuffer::SegmentAtOrBeforeOffset(
+    int offset, int* segment_offset) const {
+  int i = SegmentIndexAtOrBefore(offset);
+  if (i < 0) {
+    return nullptr;
+  }
+  if (segment_offset != nullptr) {
+    *segment_offset = segment_offsets_[i];
+  }
+  return &source_map_.segments()[segment_indices_[i]];
 }
 
 }  // namespace anodyne
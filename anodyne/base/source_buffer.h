@@ -18,10 +18,11 @@
 #define ANODYNE_BASE_SOURCE_FILE_H__
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "anodyne/base/source_map.h"
 
 #include <tuple>
-#include <unordered_map>
+#include <vector>
 
 namespace anodyne {
 
@@ -55,11 +56,51 @@ class SourceBuffer {
   /// at `offset`. The `SourceBuffer` owns this memory.
   const SourceMapSegment* SegmentForOffset(int offset) const;
 
+  /// \param offset file offset in bytes
+  /// \param segment_offset if non-null, set to the offset of the segment
+  /// that is returned.
+  /// \return null if no segment is located at or before `offset`;
+  /// otherwise, the `SourceMapSegment` located at the greatest offset that
+  /// is no greater than `offset`. The `SourceBuffer` owns this memory.
+  const SourceMapSegment* SegmentAtOrBeforeOffset(int offset,
+                                                  int* segment_offset) const;
+
   /// \param offset file offset in bytes
   /// \return (line, col), where col is the number of utf-8 code units (or
   /// a negative line on error). line and col are both 0-based.
   std::pair<int, int> Utf8LineColForOffset(int offset) const;
 
+  /// \param offset file offset in bytes
+  /// \return -1 for out of bounds; otherwise the file offset in UTF-16
+  /// units. Offsets inside a code point round up to the next one. This is
+  /// the inverse of `OffsetForUtf16Offset`.
+  int Utf16OffsetForOffset(int offset) const;
+
+  /// \param offset file offset in bytes
+  /// \return (line, col), where col is the number of UTF-16 code units (or
+  /// a negative line on error). line and col are both 0-based. This is the
+  /// inverse of `OffsetForUtf16LineCol`.
+  std::pair<int, int> Utf16LineColForOffset(int offset) const;
+
+  /// \brief A position in a buffer as a line and columns. All are 0-based,
+  /// and all are negative for offsets that are out of bounds.
+  struct LineCol {
+    int line;
+    /// The column in UTF-8 code units (as from `Utf8LineColForOffset`).
+    int utf8_col;
+    /// The column in UTF-16 code units.
+    int utf16_col;
+  };
+
+  /// \brief Finds the line and columns of each of `offsets`, which must be
+  /// sorted in ascending order, and stores them in `out`.
+  ///
+  /// This agrees with `Utf8LineColForOffset`, but sweeps the line table
+  /// once for the whole batch instead of searching it for each offset, and
+  /// decodes each line at most once to count UTF-16 code units.
+  void LineColsForSortedOffsets(absl::Span<const int> offsets,
+                                LineCol* out) const;
+
   /// \return the file's source map.
   const SourceMap& source_map() const { return source_map_; }
 
@@ -70,18 +111,54 @@ class SourceBuffer {
   int max_offset() const { return max_offset_; }
 
  private:
+  /// \brief Fills in the line tables, the UTF-16 checkpoints, `ascii_`
+  /// and (for buffers with source maps) the segment index.
+  void ScanLines();
+  /// \brief Decodes from the start of `line` (see `line_to_offset_`)
+  /// until reaching a code point boundary that the checkpoints agree with,
+  /// byte `end`, or `col` UTF-16 units.
+  /// \param utf16_col set to the number of UTF-16 units decoded.
+  /// \return the offset reached.
+  int AlignLineStart(int line, int end, int col, int* utf16_col) const;
+  /// \return the offset of the first code point at or after byte `from`
+  /// (whose UTF-16 offset is `from_utf16`) with a UTF-16 offset of at least
+  /// `utf16_offset`, or the end of the buffer.
+  int OffsetForUtf16OffsetFrom(int from, int from_utf16,
+                               int utf16_offset) const;
+
   /// The content of this file.
   std::string content_;
   /// This file's source map.
   SourceMap source_map_;
-  /// Maps byte offsets to segment indices.
-  std::unordered_map<int, int> offset_to_segment_;
+  /// \return the index into `segment_offsets_` of the greatest offset that
+  /// is no greater than `offset`, or -1 if there is none.
+  int SegmentIndexAtOrBefore(int offset) const;
+
+  /// The byte offsets at which segments are located, in ascending order.
+  std::vector<int> segment_offsets_;
+  /// The index in `source_map_.segments()` of the segment at each of
+  /// `segment_offsets_`.
+  std::vector<int> segment_indices_;
   /// Maps 0-based line numbers to cumulative byte counts.
   std::vector<int> line_to_offset_;
   /// Maps 0-based line numbers to cumulative UTF-16 code points.
   std::vector<int> line_to_utf16_offset_;
   /// This file's maximum UTF-8 offset.
   int max_offset_;
+  /// Whether this file's content is all ASCII (so that UTF-8 and UTF-16
+  /// columns are the same).
+  bool ascii_ = true;
+  /// The number of bytes before the first non-ASCII byte. These bytes are
+  /// all their own UTF-16 offsets.
+  int ascii_prefix_ = 0;
+  /// The total number of UTF-16 code units in this file.
+  int utf16_size_ = 0;
+  /// Byte offsets of code points after `ascii_prefix_`, about every 256
+  /// bytes, so that converting to and from UTF-16 offsets only has to
+  /// decode a short span. Minified files can be one very long line.
+  std::vector<int> checkpoint_offsets_;
+  /// The UTF-16 offsets of `checkpoint_offsets_`.
+  std::vector<int> checkpoint_utf16_offsets_;
 };
 
 }  // namespace anodyne
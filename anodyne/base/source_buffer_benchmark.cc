@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks building the line tables of large `SourceBuffer`s.
+
+#include "anodyne/base/source_buffer.h"
+
+#include "benchmark/benchmark.h"
+
+#include <random>
+#include <string>
+
+namespace anodyne {
+namespace {
+
+/// The size of each input.
+constexpr size_t kInputSize = 4 << 20;
+
+/// \return `kInputSize` bytes made by repeating `chunk`.
+std::string Repeat(const std::string& chunk) {
+  std::string content;
+  content.reserve(kInputSize + chunk.size());
+  while (content.size() < kInputSize) {
+    content.append(chunk);
+  }
+  return content;
+}
+
+void ScanBuffer(benchmark::State& state, const std::string& content) {
+  for (auto _ : state) {
+    SourceBuffer buffer(content, SourceMap{});
+    benchmark::DoNotOptimize(buffer.max_offset());
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+
+/// Minified JavaScript: ASCII with very long lines.
+void BM_ScanMinified(benchmark::State& state) {
+  std::string chunk;
+  for (int i = 0; i < 400; ++i) {
+    chunk.append("function(a,b){return a.x+b[\"y\"]||c(d,e)};var q=1e3;");
+  }
+  chunk.push_back('\n');
+  ScanBuffer(state, Repeat(chunk));
+}
+BENCHMARK(BM_ScanMinified);
+
+/// Ordinary ASCII source with short lines.
+void BM_ScanAsciiLines(benchmark::State& state) {
+  ScanBuffer(state, Repeat("    const x = foo(bar, baz);  // comment\n"));
+}
+BENCHMARK(BM_ScanAsciiLines);
+
+/// Source full of non-Latin string literals and comments, with some
+/// characters outside the Basic Multilingual Plane.
+constexpr char kNonLatin[] =
+    "  // Привет, мир! 你好，世界！こんにちは 😀\n"
+    "  s = \"συνάρτηση 函数 関数 𐐷\";\n";
+/// The same, minified onto one line.
+constexpr char kNonLatinMinified[] = "x=\"你好，世界\";y=f(x,'😀');";
+
+void BM_ScanNonLatin(benchmark::State& state) {
+  ScanBuffer(state, Repeat(kNonLatin));
+}
+BENCHMARK(BM_ScanNonLatin);
+
+/// Converting UTF-16 columns on one long line of minified non-Latin text,
+/// as when mapping TypeScript positions in a bundle.
+void BM_Utf16LineColMinified(benchmark::State& state) {
+  SourceBuffer buffer(Repeat(kNonLatinMinified), SourceMap{});
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> col(0, buffer.max_offset() / 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.OffsetForUtf16LineCol(0, col(random)));
+  }
+}
+BENCHMARK(BM_Utf16LineColMinified);
+
+/// \return a buffer of mixed-script text: `kNonLatinMinified` if `minified`
+/// is nonzero, `kNonLatin` otherwise.
+SourceBuffer MixedScriptBuffer(int minified) {
+  return SourceBuffer(Repeat(minified ? kNonLatinMinified : kNonLatin),
+                      SourceMap{});
+}
+
+/// UTF-16 offsets to byte offsets.
+void BM_OffsetForUtf16Offset(benchmark::State& state) {
+  SourceBuffer buffer = MixedScriptBuffer(state.range(0));
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> offset(
+      0, buffer.Utf16OffsetForOffset(buffer.max_offset()));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.OffsetForUtf16Offset(offset(random)));
+  }
+}
+BENCHMARK(BM_OffsetForUtf16Offset)->Arg(0)->Arg(1);
+
+/// Byte offsets to UTF-16 offsets.
+void BM_Utf16OffsetForOffset(benchmark::State& state) {
+  SourceBuffer buffer = MixedScriptBuffer(state.range(0));
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> offset(0, buffer.max_offset());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.Utf16OffsetForOffset(offset(random)));
+  }
+}
+BENCHMARK(BM_Utf16OffsetForOffset)->Arg(0)->Arg(1);
+
+/// Byte offsets to UTF-16 lines and columns.
+void BM_Utf16LineColForOffset(benchmark::State& state) {
+  SourceBuffer buffer = MixedScriptBuffer(state.range(0));
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> offset(0, buffer.max_offset());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.Utf16LineColForOffset(offset(random)));
+  }
+}
+BENCHMARK(BM_Utf16LineColForOffset)->Arg(0)->Arg(1);
+
+}  // anonymous namespace
+}  // namespace anodyne
@@ -68,6 +68,27 @@ TEST(SourceBufferTest, AsciiOnly) {
   EXPECT_EQ(std::make_pair(-1, -1), buffer.Utf8LineColForOffset(22));
 }
 
+TEST(SourceBufferTest, NearestSegments) {
+  SourceMap map;
+  ASSERT_TRUE(map.ParseFromJson("ascii_only", kAsciiOnly, true));
+  SourceBuffer buffer(absl::string_view(kAsciiOnlyGen), std::move(map));
+  EXPECT_TRUE(buffer.SegmentForOffset(13) == nullptr);
+  int segment_offset = -1;
+  const auto* segment = buffer.SegmentAtOrBeforeOffset(13, &segment_offset);
+  ASSERT_FALSE(segment == nullptr);
+  EXPECT_EQ(11, segment_offset);
+  EXPECT_EQ(1, segment->generated_line);
+  EXPECT_EQ(5, segment->generated_col);
+  segment = buffer.SegmentAtOrBeforeOffset(16, &segment_offset);
+  EXPECT_EQ(buffer.SegmentForOffset(16), segment);
+  EXPECT_EQ(16, segment_offset);
+  segment = buffer.SegmentAtOrBeforeOffset(100, &segment_offset);
+  ASSERT_FALSE(segment == nullptr);
+  EXPECT_EQ(21, segment_offset);
+  EXPECT_EQ(2, segment->generated_line);
+  EXPECT_EQ(5, segment->generated_col);
+}
+
 TEST(SourceBufferTest, Utf162U) {
   SourceMap map;
   ASSERT_TRUE(map.ParseFromJson("utf16_2u", kUtf162U, true));
@@ -111,5 +132,94 @@ TEST(SourceBufferTest, Utf84B) {
   EXPECT_EQ(7, buffer.OffsetForUtf16Offset(5));
 }
 
+TEST(SourceBufferTest, LongMixedLines) {
+  // Long enough to cross several vector blocks, with multibyte sequences
+  // straddling block boundaries.
+  std::string line_a = "var s = \"";
+  for (int i = 0; i < 20; ++i) {
+    line_a.append("ab€𐐷");
+  }
+  line_a.append("\";\n");
+  std::string line_b(70, 'x');
+  line_b.append("\n");
+  std::string line_c = "\xff\x80 // malformed\n";
+  SourceBuffer buffer(absl::StrCat(line_a, line_b, line_c, "end"),
+                      SourceMap{});
+  int b = line_a.size();
+  int c = b + line_b.size();
+  int end = c + line_c.size();
+  EXPECT_EQ(std::make_pair(0, b - 1), buffer.Utf8LineColForOffset(b - 1));
+  EXPECT_EQ(std::make_pair(1, 0), buffer.Utf8LineColForOffset(b + 1));
+  EXPECT_EQ(std::make_pair(1, 70), buffer.Utf8LineColForOffset(c));
+  EXPECT_EQ(std::make_pair(2, 0), buffer.Utf8LineColForOffset(c + 1));
+  EXPECT_EQ(std::make_pair(3, 0), buffer.Utf8LineColForOffset(end + 1));
+  EXPECT_EQ(std::make_pair(3, 2), buffer.Utf8LineColForOffset(end + 3));
+  // Each "ab€𐐷" is 9 bytes and 5 UTF-16 units.
+  std::vector<int> offsets = {9, 9 + 9 * 20, b + 1 + 10};
+  std::vector<SourceBuffer::LineCol> line_cols(offsets.size());
+  buffer.LineColsForSortedOffsets(offsets, line_cols.data());
+  EXPECT_EQ(0, line_cols[0].line);
+  EXPECT_EQ(9, line_cols[0].utf16_col);
+  EXPECT_EQ(9 + 5 * 20, line_cols[1].utf16_col);
+  EXPECT_EQ(1, line_cols[2].line);
+  EXPECT_EQ(line_cols[2].utf8_col, line_cols[2].utf16_col);
+}
+
+TEST(SourceBufferTest, Utf16OffsetsOnLongLines) {
+  // Minified files can be one long line; conversions shouldn't depend on
+  // scanning from its start.
+  std::string content = "var s = \"";
+  for (int i = 0; i < 2000; ++i) {
+    content.append("a€𐐷");
+  }
+  SourceBuffer buffer(content, SourceMap{});
+  // Each "a€𐐷" is 8 bytes and 4 UTF-16 units.
+  for (int i : {0, 1, 31, 32, 1000, 1999}) {
+    EXPECT_EQ(9 + 8 * i, buffer.OffsetForUtf16LineCol(0, 9 + 4 * i));
+    EXPECT_EQ(9 + 8 * i, buffer.OffsetForUtf16Offset(9 + 4 * i));
+    // Halfway through 𐐷 rounds up to the next code point.
+    EXPECT_EQ(9 + 8 * i + 8, buffer.OffsetForUtf16Offset(9 + 4 * i + 3));
+  }
+  EXPECT_EQ(content.size(), buffer.OffsetForUtf16Offset(9 + 4 * 2000));
+  EXPECT_EQ(-1, buffer.OffsetForUtf16Offset(9 + 4 * 2000 + 1));
+}
+
+TEST(SourceBufferTest, Utf16OffsetsAcrossLines) {
+  SourceBuffer buffer(absl::string_view("ab\n€c\nd"), SourceMap{});
+  EXPECT_EQ(0, buffer.OffsetForUtf16Offset(0));
+  EXPECT_EQ(3, buffer.OffsetForUtf16Offset(3));
+  EXPECT_EQ(6, buffer.OffsetForUtf16Offset(4));
+  EXPECT_EQ(8, buffer.OffsetForUtf16Offset(6));
+  EXPECT_EQ(9, buffer.OffsetForUtf16Offset(7));
+  EXPECT_EQ(-1, buffer.OffsetForUtf16Offset(8));
+  EXPECT_EQ(-1, buffer.OffsetForUtf16Offset(-1));
+}
+
+TEST(SourceBufferTest, Utf16ForOffset) {
+  SourceBuffer buffer(absl::string_view("ab\n€c\nd𐐷e"), SourceMap{});
+  EXPECT_EQ(0, buffer.Utf16OffsetForOffset(0));
+  EXPECT_EQ(3, buffer.Utf16OffsetForOffset(3));
+  // Offsets inside € round up.
+  EXPECT_EQ(4, buffer.Utf16OffsetForOffset(4));
+  EXPECT_EQ(4, buffer.Utf16OffsetForOffset(6));
+  // 𐐷 takes two UTF-16 code units.
+  EXPECT_EQ(7, buffer.Utf16OffsetForOffset(9));
+  EXPECT_EQ(9, buffer.Utf16OffsetForOffset(13));
+  EXPECT_EQ(10, buffer.Utf16OffsetForOffset(14));
+  EXPECT_EQ(-1, buffer.Utf16OffsetForOffset(15));
+  EXPECT_EQ(-1, buffer.Utf16OffsetForOffset(-1));
+  // Lines (and so columns) follow `Utf8LineColForOffset`.
+  EXPECT_EQ(std::make_pair(0, 2), buffer.Utf16LineColForOffset(2));
+  EXPECT_EQ(std::make_pair(2, 2), buffer.Utf16LineColForOffset(13));
+  EXPECT_EQ(std::make_pair(-1, -1), buffer.Utf16LineColForOffset(15));
+  for (int offset : {0, 3, 6, 7, 9, 13, 14}) {
+    EXPECT_EQ(offset, buffer.OffsetForUtf16Offset(
+                          buffer.Utf16OffsetForOffset(offset)));
+    auto line_col = buffer.Utf16LineColForOffset(offset);
+    EXPECT_EQ(offset, buffer.OffsetForUtf16LineCol(line_col.first,
+                                                   line_col.second));
+  }
+}
+
 }  // anonymous namespace
 }  // namespace anodyne
@@ -20,6 +20,8 @@
 #include "gtest/gtest.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace anodyne {
 namespace {
@@ -70,5 +72,162 @@ TEST(SourceTest, FindFile) {
   EXPECT_EQ(nullptr, source.FindFile(file_d->end()));
 }
 
+TEST(SourceTest, FindFileOwnsKeys) {
+  Source source;
+  const File* file_a;
+  {
+    std::string repo = "repo";
+    std::string path = "path";
+    file_a = source.FindFile(repo, path, "", [&](const FileId& id) {
+      return SourceBufferContaining("file_a");
+    });
+    repo.assign("xxxx");
+    path.assign("xxxx");
+  }
+  ASSERT_TRUE(file_a != nullptr);
+  auto fail = [](const FileId& id) -> std::unique_ptr<SourceBuffer> {
+    ADD_FAILURE() << "file should be cached: " << id.ToString();
+    return nullptr;
+  };
+  EXPECT_EQ(file_a, source.FindFile("repo", "path", "", fail));
+  EXPECT_EQ(nullptr, source.FindFile("xxxx", "xxxx", "", [](const FileId&) {
+              return std::unique_ptr<SourceBuffer>();
+            }));
+  const File* file_b = source.FindFile("repo", "", "path", [&](const FileId&) {
+    return SourceBufferContaining("file_b");
+  });
+  EXPECT_NE(file_a, file_b);
+  EXPECT_EQ(file_b, source.FindFile("repo", "", "path", fail));
+}
+
+TEST(SourceTest, ResolveLocations) {
+  Source source;
+  const File* ascii = AddFile(&source, "ascii", "line one\nline two\n\nend");
+  const File* empty = AddFile(&source, "empty", "");
+  // ¢ is 2 UTF-8 bytes and 1 UTF-16 unit; 𐐷 is 4 bytes and 2 units.
+  const File* wide = AddFile(&source, "wide", "a ¢ b\nc 𐐷 d 𐐷 e\nf");
+  std::vector<Location> locations = {Location{}, wide->end().offset(1)};
+  for (const File* file : {ascii, empty, wide}) {
+    for (int offset = 0; offset <= file->contents().max_offset() + 1;
+         ++offset) {
+      locations.push_back(file->begin().offset(offset));
+    }
+  }
+  // Resolve them out of order, with repeats.
+  std::vector<Location> shuffled;
+  for (size_t i = 0; i < locations.size(); ++i) {
+    shuffled.push_back(locations[(i * 7) % locations.size()]);
+    shuffled.push_back(locations[(i * 7) % locations.size()]);
+  }
+  std::vector<ResolvedLocation> resolved(shuffled.size());
+  source.ResolveLocations(shuffled, resolved.data());
+  for (size_t i = 0; i < shuffled.size(); ++i) {
+    const File* file = source.FindFile(shuffled[i]);
+    EXPECT_EQ(file, resolved[i].file) << i;
+    if (file == nullptr) {
+      EXPECT_EQ(-1, resolved[i].line);
+      continue;
+    }
+    auto line_col = file->contents().Utf8LineColForOffset(
+        shuffled[i].data() - file->begin().data());
+    EXPECT_EQ(line_col.first, resolved[i].line) << i;
+    EXPECT_EQ(line_col.second, resolved[i].utf8_col) << i;
+  }
+  // The second line of `wide` starts at byte 7; this is just past its 𐐷.
+  Location after_wide[] = {wide->begin().offset(7 + 6)};
+  ResolvedLocation wide_resolved;
+  source.ResolveLocations(after_wide, &wide_resolved);
+  EXPECT_EQ(1, wide_resolved.line);
+  EXPECT_EQ(wide_resolved.utf8_col - 2, wide_resolved.utf16_col);
+}
+
+TEST(SourceTest, LoadsLazily) {
+  Source source;
+  int loads = 0;
+  auto find = [&](absl::string_view path, absl::string_view content) {
+    return source.FindLazyFile(
+        "repo", path, "", [&](const FileId&) { return content.size(); },
+        [&, content](const FileId&) {
+          ++loads;
+          return SourceBufferContaining(content);
+        });
+  };
+  const File* file_a = find("a", "file_a");
+  const File* file_b = find("b", "file_b\nline");
+  ASSERT_TRUE(file_a != nullptr && file_b != nullptr);
+  EXPECT_EQ(0, loads);
+  EXPECT_EQ(file_b, source.FindFile(file_b->begin().offset(3)));
+  EXPECT_EQ(file_a, find("a", "ignored"));
+  EXPECT_EQ("file_b", file_b->Text(file_b->begin(), file_b->begin().offset(6)));
+  EXPECT_EQ(1, loads);
+  EXPECT_FALSE(file_a->is_resident());
+  EXPECT_EQ("file_a", file_a->Text(file_a->begin(), file_a->end()));
+  EXPECT_EQ(2, loads);
+  EXPECT_EQ(17, source.lazy_resident_bytes());
+  // file_b was used least recently.
+  source.EvictContents(10);
+  EXPECT_TRUE(file_a->is_resident());
+  EXPECT_FALSE(file_b->is_resident());
+  auto pinned = file_a->PinContents();
+  source.EvictContents(0);
+  EXPECT_TRUE(file_a->is_resident());
+  EXPECT_EQ(1, file_b->contents().Utf8LineColForOffset(8).first);
+  EXPECT_EQ(3, loads);
+  pinned.reset();
+  source.EvictContents(0);
+  EXPECT_EQ(0, source.lazy_resident_bytes());
+}
+
+TEST(SourceTest, SharesIdenticalContents) {
+  Source source;
+  const auto* file_a = AddFile(&source, "a", "same\ntext");
+  const auto* file_b = AddFile(&source, "b", "same\ntext");
+  const auto* file_c = AddFile(&source, "c", "other");
+  // This has the same size as the first two but different text.
+  const auto* file_d = AddFile(&source, "d", "same\nnext");
+  ASSERT_TRUE(file_a != nullptr && file_b != nullptr && file_c != nullptr &&
+              file_d != nullptr);
+  EXPECT_EQ(&file_a->contents(), &file_b->contents());
+  EXPECT_NE(&file_a->contents(), &file_c->contents());
+  EXPECT_NE(&file_a->contents(), &file_d->contents());
+  EXPECT_EQ(3, source.shared_buffer_count());
+  // Each file still has its own `Location`s.
+  EXPECT_NE(file_a->begin().data(), file_b->begin().data());
+  EXPECT_EQ(file_b, source.FindFile(file_b->begin().offset(5)));
+  EXPECT_EQ("text", file_b->Text(file_b->begin().offset(5), file_b->end()));
+  // Lazily loaded contents are shared too, and counted once.
+  auto find = [&](absl::string_view path) {
+    return source.FindLazyFile(
+        "repo", path, "", [](const FileId&) { return 4; },
+        [](const FileId&) { return SourceBufferContaining("lazy"); });
+  };
+  const File* lazy_a = find("lazy_a");
+  const File* lazy_b = find("lazy_b");
+  EXPECT_EQ(&lazy_a->contents(), &lazy_b->contents());
+  EXPECT_EQ(4, source.lazy_resident_bytes());
+  EXPECT_EQ(4, source.shared_buffer_count());
+  source.EvictContents(0);
+  EXPECT_FALSE(lazy_a->is_resident());
+  EXPECT_FALSE(lazy_b->is_resident());
+  EXPECT_EQ(0, source.lazy_resident_bytes());
+  // Reloaded contents are shared again.
+  EXPECT_EQ(&lazy_a->contents(), &lazy_b->contents());
+  EXPECT_EQ(4, source.lazy_resident_bytes());
+}
+
+TEST(SourceTest, LazyLoadFailures) {
+  Source source;
+  EXPECT_EQ(nullptr,
+            source.FindLazyFile(
+                "repo", "missing", "", [](const FileId&) { return -1; },
+                [](const FileId&) { return nullptr; }));
+  const File* changed = source.FindLazyFile(
+      "repo", "changed", "", [](const FileId&) { return 4; },
+      [](const FileId&) { return SourceBufferContaining("changed"); });
+  ASSERT_TRUE(changed != nullptr);
+  EXPECT_EQ("", changed->Text(changed->begin(), changed->end()));
+  EXPECT_EQ(0, changed->contents().max_offset());
+}
+
 }  // anonymous namespace
 }  // namespace anodyne
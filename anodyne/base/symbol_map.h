@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANODYNE_BASE_SYMBOL_MAP_H_
+#define ANODYNE_BASE_SYMBOL_MAP_H_
+
+#include "anodyne/base/symbol_table.h"
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+namespace anodyne {
+
+/// \brief Associates a `T` with every `Symbol`.
+///
+/// Since interned `Symbol`s are numbered densely from 0, their values are
+/// kept in arrays indexed directly by `Symbol`. The arrays are pages that
+/// double in size and are allocated the first time one of their entries is
+/// written, so the map grows along with the `SymbolTable` and entries never
+/// move. Gensyms are numbered from 2^31 and are usually few, so they're kept
+/// in a hash map instead.
+///
+/// Every `Symbol` starts out mapped to `T()`; use a `T` like `const Foo*`
+/// or `absl::optional<Foo>` to tell set entries from unset ones. A
+/// `SymbolMap` isn't safe to write from several threads at once.
+template <typename T>
+class SymbolMap {
+ public:
+  SymbolMap() = default;
+  SymbolMap(const SymbolMap&) = delete;
+  SymbolMap& operator=(const SymbolMap&) = delete;
+
+  /// \return the value for `symbol`, allocating it if need be.
+  T& operator[](Symbol symbol) {
+    if (SymbolTable::is_gensym(symbol)) {
+      return gensyms_[symbol];
+    }
+    size_t page = SymbolPages::PageFor(symbol);
+    if (pages_[page] == nullptr) {
+      pages_[page].reset(new T[SymbolPages::PageSize(page)]());
+    }
+    return pages_[page][symbol - SymbolPages::PageBase(page)];
+  }
+  /// \return the value for `symbol`, which is `T()` if it was never set.
+  const T& Get(Symbol symbol) const {
+    if (SymbolTable::is_gensym(symbol)) {
+      auto it = gensyms_.find(symbol);
+      return it == gensyms_.end() ? default_ : it->second;
+    }
+    size_t page = SymbolPages::PageFor(symbol);
+    return pages_[page] == nullptr
+               ? default_
+               : pages_[page][symbol - SymbolPages::PageBase(page)];
+  }
+  /// \brief Allocates the pages for every `Symbol` below `symbol_count` (for
+  /// example, `SymbolTable::symbol_count()`) so that writing to them doesn't
+  /// need to.
+  void Reserve(size_t symbol_count) {
+    for (size_t page = 0; page < SymbolPages::kPageCount &&
+                          SymbolPages::PageBase(page) < symbol_count;
+         ++page) {
+      if (pages_[page] == nullptr) {
+        pages_[page].reset(new T[SymbolPages::PageSize(page)]());
+      }
+    }
+  }
+
+ private:
+  /// Values for non-gensym `Symbol`s, or null for pages not yet written.
+  std::unique_ptr<T[]> pages_[SymbolPages::kPageCount];
+  /// Values for gensyms.
+  std::unordered_map<Symbol, T> gensyms_;
+  /// Returned for entries that were never set.
+  const T default_ = T();
+};
+
+}  // namespace anodyne
+
+#endif  // ANODYNE_BASE_SYMBOL_MAP_H_
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/symbol_map.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+namespace anodyne {
+namespace {
+
+TEST(SymbolMap, MapsInternedSymbols) {
+  SymbolTable table;
+  SymbolMap<int> map;
+  std::vector<Symbol> symbols;
+  for (int i = 0; i < 10000; ++i) {
+    symbols.push_back(table.Intern(absl::StrCat("symbol", i)));
+    map[symbols.back()] = i + 1;
+  }
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ(i + 1, map.Get(symbols[i]));
+  }
+  EXPECT_EQ(0, map.Get(well_known::kThis));
+  EXPECT_EQ(0, map.Get(table.Intern("unset")));
+}
+
+TEST(SymbolMap, MapsGensyms) {
+  SymbolTable table;
+  SymbolMap<std::string> map;
+  Symbol gensym = table.Gensym();
+  Symbol other = table.Gensym();
+  map[gensym] = "gensym";
+  map[table.Intern("symbol")] = "symbol";
+  EXPECT_EQ("gensym", map.Get(gensym));
+  EXPECT_EQ("", map.Get(other));
+  EXPECT_EQ("symbol", map.Get(table.Intern("symbol")));
+}
+
+TEST(SymbolMap, EntriesDontMove) {
+  SymbolMap<int> map;
+  int* first = &map[0];
+  map.Reserve(100000);
+  map[99999] = 1;
+  map[12345678] = 2;
+  EXPECT_EQ(first, &map[0]);
+  EXPECT_EQ(1, map.Get(99999));
+  EXPECT_EQ(2, map.Get(12345678));
+  EXPECT_EQ(0, map.Get(12345679));
+}
+
+}  // anonymous namespace
+}  // namespace anodyne
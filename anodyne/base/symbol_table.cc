@@ -0,0 +1,432 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anodyne/base/symbol_table.h"
+
+#include "glog/logging.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace anodyne {
+namespace {
+/// Identifies image files.
+constexpr char kImageMagic[8] = {'a', 'n', 'o', 'd', 's', 'y', 'm', 't'};
+/// Changes whenever the layout of image files (or `StableHash`) does.
+constexpr uint32_t kImageVersion = 1;
+
+/// \brief The start of an image file.
+///
+/// The header is followed by `index_size` `ImageSlot`s, `symbol_count + 1`
+/// `uint32_t` text offsets, and `text_size` bytes of concatenated symbol
+/// text.
+struct ImageHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t symbol_count;
+  uint32_t index_size;
+  uint32_t reserved;
+  uint64_t text_size;
+};
+
+/// \brief An entry in an image's index. The index is an open-addressing
+/// table with linear probing, indexed by the low bits of `StableHash`.
+struct ImageSlot {
+  /// The high bits of the symbol's `StableHash`.
+  uint32_t tag;
+  /// The symbol plus one, or 0 if the slot is empty.
+  uint32_t symbol;
+};
+
+/// \return a hash of `text` that's the same in every process (unlike
+/// `absl::Hash`, which is seeded).
+uint64_t StableHash(absl::string_view text) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash ^ (hash >> 29);
+}
+
+/// \brief Writes `size` bytes from `data` to `file`.
+/// \return false on failure.
+bool WriteBytes(const void* data, size_t size, FILE* file) {
+  return size == 0 || fwrite(data, size, 1, file) == 1;
+}
+
+/// Used to give each `SymbolTable` a distinct id.
+std::atomic<uint64_t> next_table_id{1};
+}  // anonymous namespace
+
+thread_local SymbolTable::GensymCache SymbolTable::gensym_cache_;
+
+struct SymbolTable::Image {
+  ~Image() { munmap(mapping, mapping_size); }
+  /// The mapped file.
+  void* mapping;
+  /// The size of `mapping` in bytes.
+  size_t mapping_size;
+  /// The index, pointing into `mapping`.
+  const ImageSlot* index;
+  /// The number of slots in `index` minus one.
+  uint32_t index_mask;
+};
+
+SymbolTable::SymbolTable(const Options& options)
+    : concurrent_(options.concurrent),
+      well_known_count_(options.well_known_symbols ? well_known::kCount : 0),
+      id_(next_table_id.fetch_add(1, std::memory_order_relaxed)) {
+  size_t shard_count = 1;
+  if (concurrent_) {
+    while (shard_count < options.shard_count) {
+      shard_count *= 2;
+    }
+  }
+  shard_mask_ = shard_count - 1;
+  shards_.reset(new Shard[shard_count]);
+  for (auto& page : pages_) {
+    page.store(nullptr, std::memory_order_relaxed);
+  }
+  // The well-known symbols' text is static, so it doesn't need copying.
+  for (Symbol symbol = 0; symbol < well_known_count_; ++symbol) {
+    absl::string_view text = well_known::Text(symbol);
+    size_t hash = shards_[0].symbol_map.HashOf(text);
+    Shard& shard = concurrent_ ? ShardFor(hash) : shards_[0];
+    *TextSlot(symbol) = text;
+    shard.symbol_map.Insert(text, symbol, hash);
+  }
+  next_symbol_.store(well_known_count_, std::memory_order_relaxed);
+}
+
+SymbolTable::~SymbolTable() {
+  for (auto& page : pages_) {
+    delete[] page.load(std::memory_order_relaxed);
+  }
+}
+
+Symbol SymbolTable::Intern(absl::string_view text) {
+  Symbol base_symbol;
+  if (base_count_ != 0 && FindInBase(text, &base_symbol)) {
+    return base_symbol;
+  }
+  if (!concurrent_) {
+    Shard& shard = shards_[0];
+    size_t hash = shard.symbol_map.HashOf(text);
+    if (const Symbol* symbol = shard.symbol_map.Find(text, hash)) {
+      return *symbol;
+    }
+    return AddUnshared(text, hash);
+  }
+  size_t hash = shards_[0].symbol_map.HashOf(text);
+  Shard& shard = ShardFor(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (const Symbol* symbol = shard.symbol_map.Find(text, hash)) {
+    return *symbol;
+  }
+  Symbol symbol = next_symbol_.fetch_add(1, std::memory_order_acq_rel);
+  Add(&shard, text, hash, symbol);
+  return symbol;
+}
+
+bool SymbolTable::Find(absl::string_view text, Symbol* symbol) const {
+  if (base_count_ != 0 && FindInBase(text, symbol)) {
+    return true;
+  }
+  size_t hash = shards_[0].symbol_map.HashOf(text);
+  Shard& shard = concurrent_ ? ShardFor(hash) : shards_[0];
+  std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+  if (concurrent_) {
+    lock.lock();
+  }
+  const Symbol* found = shard.symbol_map.Find(text, hash);
+  if (found == nullptr) {
+    return false;
+  }
+  *symbol = *found;
+  return true;
+}
+
+void SymbolTable::InternBatch(absl::Span<const absl::string_view> texts,
+                              Symbol* out) {
+  if (concurrent_) {
+    // Other threads may be resizing the maps, so don't look at them without
+    // holding locks.
+    for (size_t i = 0; i < texts.size(); ++i) {
+      out[i] = Intern(texts[i]);
+    }
+    return;
+  }
+  // Work in chunks small enough to keep their hashes in registers or L1 but
+  // large enough to have many cache misses in flight at once.
+  constexpr size_t kChunk = 16;
+  size_t hashes[kChunk];
+  auto& map = shards_[0].symbol_map;
+  for (size_t begin = 0; begin < texts.size(); begin += kChunk) {
+    size_t count = std::min(kChunk, texts.size() - begin);
+    const absl::string_view* chunk = texts.data() + begin;
+    for (size_t i = 0; i < count; ++i) {
+      hashes[i] = map.HashOf(chunk[i]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      map.Prefetch(hashes[i]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      if (base_count_ != 0 && FindInBase(chunk[i], &out[begin + i])) {
+        continue;
+      }
+      const Symbol* symbol = map.Find(chunk[i], hashes[i]);
+      out[begin + i] = symbol != nullptr ? *symbol
+                                         : AddUnshared(chunk[i], hashes[i]);
+    }
+  }
+}
+
+Symbol SymbolTable::AddUnshared(absl::string_view text, size_t hash) {
+  Symbol symbol = next_symbol_.load(std::memory_order_relaxed);
+  Add(&shards_[0], text, hash, symbol);
+  next_symbol_.store(symbol + 1, std::memory_order_release);
+  return symbol;
+}
+
+void SymbolTable::Add(Shard* shard, absl::string_view text, size_t hash,
+                      Symbol symbol) {
+  assert(symbol < kGensymBase);
+  char* copy = static_cast<char*>(shard->text_arena.New(text.size(), 1));
+  memcpy(copy, text.data(), text.size());
+  absl::string_view stored(copy, text.size());
+  *TextSlot(symbol) = stored;
+  shard->symbol_map.Insert(stored, symbol, hash);
+}
+
+absl::string_view* SymbolTable::TextSlot(Symbol symbol) {
+  size_t page = SymbolPages::PageFor(symbol);
+  absl::string_view* data = pages_[page].load(std::memory_order_acquire);
+  if (data == nullptr) {
+    auto* fresh = new absl::string_view[SymbolPages::PageSize(page)];
+    if (pages_[page].compare_exchange_strong(data, fresh,
+                                             std::memory_order_acq_rel)) {
+      data = fresh;
+    } else {
+      // Another thread got there first; `data` now holds its page.
+      delete[] fresh;
+    }
+  }
+  return &data[symbol - SymbolPages::PageBase(page)];
+}
+
+Symbol SymbolTable::ConcurrentGensym() {
+  GensymRange* range = gensym_cache_.owner == id_ ? gensym_cache_.range
+                                                  : ThreadGensymRangeSlow();
+  if (range->next == range->limit) {
+    uint32_t next = gensym_.fetch_add(kGensymRange, std::memory_order_acq_rel);
+    // `gensym_` wraps around (into interned symbols) when it runs out.
+    CHECK(next >= kGensymBase && next <= UINT32_MAX - kGensymRange + 1)
+        << "out of gensyms";
+    range->next = next;
+    range->limit = next + kGensymRange;
+  }
+  return range->next++;
+}
+
+SymbolTable::GensymRange* SymbolTable::ThreadGensymRangeSlow() {
+  std::lock_guard<std::mutex> lock(gensym_mutex_);
+  GensymRange* range = &gensym_ranges_[std::this_thread::get_id()];
+  gensym_cache_.owner = id_;
+  gensym_cache_.range = range;
+  return range;
+}
+
+bool SymbolTable::FindInBase(absl::string_view text, Symbol* symbol) const {
+  uint64_t hash = StableHash(text);
+  uint32_t tag = hash >> 32;
+  // `OpenImage` doesn't check the index, so don't trust it to have an empty
+  // slot or to hold only valid symbols.
+  uint32_t i = hash;
+  for (uint32_t probes = 0; probes <= image_->index_mask; ++probes, ++i) {
+    const ImageSlot& slot = image_->index[i & image_->index_mask];
+    if (slot.symbol == 0) {
+      return false;
+    }
+    if (slot.tag == tag && slot.symbol <= base_count_ &&
+        Text(slot.symbol - 1) == text) {
+      *symbol = slot.symbol - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SymbolTable::WriteImage(const std::string& path) const {
+  size_t symbol_count = this->symbol_count();
+  std::vector<uint32_t> offsets;
+  offsets.reserve(symbol_count + 1);
+  uint64_t text_size = 0;
+  for (Symbol s = 0; s < symbol_count; ++s) {
+    offsets.push_back(text_size);
+    text_size += Text(s).size();
+  }
+  offsets.push_back(text_size);
+  if (text_size > UINT32_MAX) {
+    LOG(ERROR) << "symbol text is too large for an image";
+    return false;
+  }
+  // Keep the index at most half full so that probes stay short.
+  uint32_t index_size = 1;
+  while (index_size < symbol_count * 2) {
+    index_size *= 2;
+  }
+  std::vector<ImageSlot> index(index_size, ImageSlot{0, 0});
+  for (Symbol s = 0; s < symbol_count; ++s) {
+    uint64_t hash = StableHash(Text(s));
+    uint32_t i = hash;
+    while (index[i & (index_size - 1)].symbol != 0) {
+      ++i;
+    }
+    index[i & (index_size - 1)] = ImageSlot{static_cast<uint32_t>(hash >> 32),
+                                            static_cast<uint32_t>(s + 1)};
+  }
+  ImageHeader header;
+  memcpy(header.magic, kImageMagic, sizeof(kImageMagic));
+  header.version = kImageVersion;
+  header.symbol_count = symbol_count;
+  header.index_size = index_size;
+  header.reserved = 0;
+  header.text_size = text_size;
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    PLOG(ERROR) << "could not open " << path;
+    return false;
+  }
+  bool ok = WriteBytes(&header, sizeof(header), file) &&
+            WriteBytes(index.data(), index.size() * sizeof(ImageSlot), file) &&
+            WriteBytes(offsets.data(), offsets.size() * sizeof(uint32_t), file);
+  for (Symbol s = 0; ok && s < symbol_count; ++s) {
+    auto text = Text(s);
+    ok = WriteBytes(text.data(), text.size(), file);
+  }
+  if (!ok) {
+    PLOG(ERROR) << "could not write " << path;
+  }
+  if (fclose(file) != 0) {
+    PLOG(ERROR) << "could not close " << path;
+    ok = false;
+  }
+  return ok;
+}
+
+bool SymbolTable::OpenImage(const std::string& path) {
+  if (symbol_count() != well_known_count_ || image_ != nullptr) {
+    LOG(ERROR) << "images can only be opened in fresh tables";
+    return false;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    PLOG(ERROR) << "could not open " << path;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    PLOG(ERROR) << "could not stat " << path;
+    close(fd);
+    return false;
+  }
+  size_t file_size = st.st_size;
+  if (file_size < sizeof(ImageHeader)) {
+    LOG(ERROR) << path << " is too small to be a symbol image";
+    close(fd);
+    return false;
+  }
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "could not map " << path;
+    return false;
+  }
+  // Take ownership of the mapping now so that it is released on failure.
+  std::unique_ptr<Image> image(new Image{mapping, file_size, nullptr, 0});
+  const char* bytes = static_cast<const char*>(mapping);
+  ImageHeader header;
+  memcpy(&header, bytes, sizeof(header));
+  if (memcmp(header.magic, kImageMagic, sizeof(kImageMagic)) != 0 ||
+      header.version != kImageVersion) {
+    LOG(ERROR) << path << " is not a compatible symbol image";
+    return false;
+  }
+  uint64_t index_bytes = uint64_t{header.index_size} * sizeof(ImageSlot);
+  uint64_t offset_bytes =
+      (uint64_t{header.symbol_count} + 1) * sizeof(uint32_t);
+  if (header.symbol_count >= kGensymBase ||
+      header.index_size <= header.symbol_count ||
+      (header.index_size & (header.index_size - 1)) != 0 ||
+      sizeof(ImageHeader) + index_bytes + offset_bytes + header.text_size !=
+          file_size) {
+    LOG(ERROR) << path << " is truncated or corrupt";
+    return false;
+  }
+  const auto* index =
+      reinterpret_cast<const ImageSlot*>(bytes + sizeof(ImageHeader));
+  const auto* offsets = reinterpret_cast<const uint32_t*>(
+      bytes + sizeof(ImageHeader) + index_bytes);
+  const char* text = bytes + sizeof(ImageHeader) + index_bytes + offset_bytes;
+  // `Text` trusts the offsets, so check them all up front.
+  if (offsets[0] != 0 || offsets[header.symbol_count] != header.text_size) {
+    LOG(ERROR) << path << " is truncated or corrupt";
+    return false;
+  }
+  for (uint32_t s = 0; s < header.symbol_count; ++s) {
+    if (offsets[s] > offsets[s + 1]) {
+      LOG(ERROR) << path << " is truncated or corrupt";
+      return false;
+    }
+  }
+  // The well-known symbols' ids are compiled in, so they must match.
+  if (header.symbol_count < well_known_count_) {
+    LOG(ERROR) << path << " has symbols that disagree with the table";
+    return false;
+  }
+  for (Symbol s = 0; s < well_known_count_; ++s) {
+    if (absl::string_view(text + offsets[s], offsets[s + 1] - offsets[s]) !=
+        well_known::Text(s)) {
+      LOG(ERROR) << path << " has symbols that disagree with the table";
+      return false;
+    }
+  }
+  image->index = index;
+  image->index_mask = header.index_size - 1;
+  image_ = std::move(image);
+  base_offsets_ = offsets;
+  base_text_ = text;
+  base_count_ = header.symbol_count;
+  next_symbol_.store(base_count_, std::memory_order_release);
+  return true;
+}
+
+void SymbolTable::ReserveGensyms(Symbol limit) {
+  Symbol current = gensym_.load(std::memory_order_relaxed);
+  while (current < limit &&
+         !gensym_.compare_exchange_weak(current, limit,
+                                        std::memory_order_acq_rel)) {
+  }
+}
+
+}  // namespace anodyne
@@ -18,31 +18,107 @@
 #define ANODYNE_BASE_SYMBOL_TABLE_H_
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "anodyne/base/arena.h"
+#include "anodyne/base/arena_containers.h"
+#include "anodyne/base/well_known_symbols.h"
 
+#include <atomic>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
-#include <vector>
 
 namespace anodyne {
 
 /// \brief a symbol in some SymbolTable.
 using Symbol = uint32_t;
 
+/// \brief The layout of arrays indexed by non-gensym `Symbol`s, shared by
+/// `SymbolTable` and `SymbolMap`.
+///
+/// Entries are kept in pages that double in size, so that an array can grow
+/// along with its `SymbolTable` without moving the entries it already has.
+struct SymbolPages {
+  /// The number of entries in the first page.
+  static constexpr size_t kFirstPageSize = 256;
+  /// Enough pages to hold every non-gensym `Symbol`.
+  static constexpr size_t kPageCount = 24;
+  /// \return the page holding `symbol`.
+  static size_t PageFor(Symbol symbol) {
+    return 63 - __builtin_clzll(symbol / kFirstPageSize + 1);
+  }
+  /// \return the first `Symbol` in `page`.
+  static size_t PageBase(size_t page) {
+    return kFirstPageSize * ((size_t{1} << page) - 1);
+  }
+  /// \return the number of entries in `page`.
+  static size_t PageSize(size_t page) { return kFirstPageSize << page; }
+};
+
 /// \brief Interns strings of bytes.
+///
+/// Symbol text is copied once, into an `Arena` owned by the table, and is
+/// indexed by `ArenaHashMap`s keyed on views of that text. Looking up a
+/// string that has already been interned doesn't allocate.
+///
+/// A table can be made safe to use from many threads at once by setting
+/// `Options::concurrent`. Its index is then split into shards, each with
+/// its own lock, and each thread hands out gensyms from its own range.
+/// Symbols are still numbered densely from 0 in the order they were
+/// interned, so side tables can be indexed by them. `Text` never locks;
+/// a thread may look up any `Symbol` it has been handed (through some
+/// synchronized means) by the thread that interned it.
+///
+/// Unless `Options::well_known_symbols` is false, every table starts out
+/// holding the symbols listed in `well_known_symbols.txt`, numbered from 0
+/// in that order. Code can compare
+/// against the constants in `anodyne::well_known` (or map text to them at
+/// compile time with `well_known::Find`) instead of interning these.
+///
+/// A table's symbols can be saved to an image file with `WriteImage` and
+/// mapped back into a fresh table with `OpenImage`. The image is a
+/// read-only base layer: its symbols keep their ids and their text is used
+/// in place, and symbols interned afterwards go into an overlay.
 class SymbolTable {
  public:
-  SymbolTable() {}
+  /// \brief Configures a `SymbolTable`.
+  struct Options {
+    /// Whether `Intern` and `Gensym` may be called from several threads at
+    /// once.
+    bool concurrent = false;
+    /// The number of shards to split the index into if `concurrent`.
+    /// Rounded up to a power of two.
+    size_t shard_count = 64;
+    /// Whether to start out holding the well-known symbols. Tables that
+    /// never hold JavaScript identifiers (like file names) can skip them;
+    /// their symbols are then numbered from 0 instead.
+    bool well_known_symbols = true;
+  };
+  SymbolTable() : SymbolTable(Options()) {}
+  explicit SymbolTable(const Options& options);
   SymbolTable(const SymbolTable&) = delete;
   SymbolTable& operator=(const SymbolTable&) = delete;
+  ~SymbolTable();
   /// \brief Given a non-gensym `Symbol`, return a string that can be used to
   /// look it up.
   absl::string_view Text(Symbol symbol) const {
     assert(symbol < kGensymBase);
-    return symbol_text_[symbol];
+    if (symbol < base_count_) {
+      return absl::string_view(base_text_ + base_offsets_[symbol],
+                               base_offsets_[symbol + 1] -
+                                   base_offsets_[symbol]);
+    }
+    size_t page = SymbolPages::PageFor(symbol);
+    return pages_[page].load(
+        std::memory_order_acquire)[symbol - SymbolPages::PageBase(page)];
   }
   /// \return whether `symbol` was generated with `Gensym`.
-  bool is_gensym(Symbol symbol) const { return symbol >= kGensymBase; }
+  static bool is_gensym(Symbol symbol) { return symbol >= kGensymBase; }
   /// \return a text equivalent for `symbol`.
   std::string Expand(Symbol symbol) const {
     if (is_gensym(symbol)) {
@@ -52,25 +128,146 @@ class SymbolTable {
     }
   }
   /// \brief Returns the `Symbol` equivalent for `text`.
-  Symbol Intern(absl::string_view text) {
-    assert(symbol_text_.size() < kGensymBase);
-    const auto it = symbol_map_.find(std::string(text));
-    if (it != symbol_map_.end()) {
-      return it->second;
-    }
-    symbol_map_[std::string(text)] = static_cast<Symbol>(symbol_text_.size());
-    symbol_text_.push_back(std::string(text));
-    return symbol_text_.size() - 1;
-  }
+  Symbol Intern(absl::string_view text);
+  /// \brief Looks up `text` without interning it.
+  /// \return whether `text` has been interned (in which case `symbol` is
+  /// set to its `Symbol`).
+  bool Find(absl::string_view text, Symbol* symbol) const;
+  /// \brief Interns each of `texts`, storing the results in `out` (which
+  /// must have room for `texts.size()` symbols).
+  ///
+  /// This is faster than calling `Intern` on each text in turn: the texts
+  /// are hashed in groups, and their index entries are prefetched before
+  /// they're needed, so that cache misses overlap.
+  void InternBatch(absl::Span<const absl::string_view> texts, Symbol* out);
   /// \brief Return a symbol guaranteed to never match one of the other symbols
   /// in this `SymbolTable`.
-  Symbol Gensym() { return gensym_++; }
+  Symbol Gensym() {
+    if (concurrent_) {
+      return ConcurrentGensym();
+    }
+    Symbol symbol = gensym_.load(std::memory_order_relaxed);
+    assert(symbol >= kGensymBase && "out of gensyms");
+    gensym_.store(symbol + 1, std::memory_order_relaxed);
+    return symbol;
+  }
+  /// \return the number of non-gensym `Symbol`s interned so far. These are
+  /// numbered densely from 0. If other threads are interning symbols, the
+  /// text of the most recent ones may not be visible yet.
+  size_t symbol_count() const {
+    return next_symbol_.load(std::memory_order_acquire);
+  }
+  /// \return a `Symbol` that no call to `Gensym` has returned or will
+  /// return from a range handed out so far.
+  Symbol gensym_limit() const {
+    return gensym_.load(std::memory_order_acquire);
+  }
+  /// \brief Makes sure that `Gensym` never returns a `Symbol` below `limit`
+  /// (other than from ranges that threads have already claimed).
+  void ReserveGensyms(Symbol limit);
+
+  /// \brief Saves the text of every non-gensym `Symbol` (along with an
+  /// index over it) to `path`. Gensyms aren't saved. This must not run
+  /// while other threads are interning symbols.
+  /// \return false on failure.
+  bool WriteImage(const std::string& path) const;
+  /// \brief Maps the image at `path` into this table as its base layer.
+  ///
+  /// The table must not have interned anything yet, and no other thread may
+  /// use it until this returns. Every `Symbol` in the image gets the id it
+  /// had in the table that wrote it.
+  /// \return false on failure, leaving the table unchanged.
+  bool OpenImage(const std::string& path);
+  /// \return the number of symbols in the base image (or 0 if there isn't
+  /// one). These are the `Symbol`s below `base_count()`.
+  size_t base_count() const { return base_count_; }
 
  private:
-  std::unordered_map<std::string, Symbol> symbol_map_;
-  std::vector<std::string> symbol_text_;
+  /// \brief A mapped image. Defined in symbol_table.cc.
+  struct Image;
+  /// \brief Part of the index, along with the text it refers to.
+  struct Shard {
+    /// Held while using the shard if the table is concurrent.
+    std::mutex mutex;
+    /// Holds the text of the shard's symbols.
+    Arena text_arena;
+    /// Maps text (in `text_arena`) to symbols.
+    ArenaHashMap<absl::string_view, Symbol> symbol_map{&text_arena};
+  };
+  /// \brief Copies `text` into `shard` and records it as `symbol`.
+  /// \param hash the hash of `text` in `shard`'s map.
+  void Add(Shard* shard, absl::string_view text, size_t hash, Symbol symbol);
+  /// \brief Adds `text` (with hash `hash`) as the next `Symbol` of a table
+  /// that isn't concurrent.
+  Symbol AddUnshared(absl::string_view text, size_t hash);
+  /// \brief Looks `text` up in the base image.
+  /// \return whether it was found (in which case `symbol` is set).
+  bool FindInBase(absl::string_view text, Symbol* symbol) const;
+  /// \return the shard of a concurrent table that holds text with the
+  /// given hash. This uses the high bits of the hash, since the shard's
+  /// map uses the low ones.
+  Shard& ShardFor(size_t hash) const {
+    return shards_[(hash >> 48) & shard_mask_];
+  }
+  /// \brief A range of gensyms claimed by one thread.
+  struct GensymRange {
+    /// The next gensym to hand out.
+    uint32_t next = 0;
+    /// The end of the range.
+    uint32_t limit = 0;
+  };
+  /// \brief The range of the last concurrent table a thread took a gensym
+  /// from.
+  struct GensymCache {
+    /// The `id_` of the cached table, or 0.
+    uint64_t owner = 0;
+    /// The calling thread's range in that table.
+    GensymRange* range = nullptr;
+  };
+  /// \brief Hands out a gensym from the calling thread's range.
+  Symbol ConcurrentGensym();
+  /// \return the calling thread's range, creating it if necessary.
+  GensymRange* ThreadGensymRangeSlow();
+  /// \return the slot for `symbol`'s text, allocating its page if needed.
+  absl::string_view* TextSlot(Symbol symbol);
+  /// The number of gensyms a thread claims at a time in concurrent tables.
+  static constexpr uint32_t kGensymRange = 1024;
   static constexpr uint32_t kGensymBase = 0x80000000;
-  uint32_t gensym_ = kGensymBase;
+
+  /// Whether this table may be used from several threads.
+  const bool concurrent_;
+  /// The number of well-known symbols the table started out with (either
+  /// `well_known::kCount` or 0).
+  const Symbol well_known_count_;
+  /// Distinguishes this table from others in thread-local caches.
+  const uint64_t id_;
+  /// `shard_count - 1`.
+  size_t shard_mask_ = 0;
+  /// The shards of the index.
+  std::unique_ptr<Shard[]> shards_;
+  /// The pages of symbol text (laid out as `SymbolPages`), or null for
+  /// pages that aren't needed yet. This lets `Text` find a symbol without
+  /// locking, since pages never move.
+  std::atomic<absl::string_view*> pages_[SymbolPages::kPageCount];
+  /// The next `Symbol` to intern.
+  std::atomic<uint32_t> next_symbol_{0};
+  /// The next gensym (or range of gensyms) to hand out.
+  std::atomic<uint32_t> gensym_{kGensymBase};
+  /// Guards `gensym_ranges_`.
+  std::mutex gensym_mutex_;
+  /// Each thread's range of gensyms, if the table is concurrent. Threads
+  /// keep their ranges when they switch between tables.
+  std::unordered_map<std::thread::id, GensymRange> gensym_ranges_;
+  static thread_local GensymCache gensym_cache_;
+  /// The base image, or null.
+  std::unique_ptr<Image> image_;
+  /// The number of symbols in `image_`.
+  Symbol base_count_ = 0;
+  /// Where each base symbol's text starts in `base_text_`. There are
+  /// `base_count_ + 1` of these; the last marks the end of the text.
+  const uint32_t* base_offsets_ = nullptr;
+  /// The text of the base symbols, concatenated.
+  const char* base_text_ = nullptr;
 };
 
 /// \brief Specialization for storing slices of Symbols (which aren't
@@ -109,6 +306,59 @@ inline ArenaOption<Symbol> Some(Symbol content) {
 }
 
 inline ArenaOption<Symbol> None() { return ArenaOption<Symbol>(false, 0); }
+
+/// \brief Interns `texts` in `symbol_table` as a slice allocated in `arena`.
+inline ArenaSlice<Symbol> InternSlice(
+    SymbolTable* symbol_table, Arena* arena,
+    absl::Span<const absl::string_view> texts) {
+  auto* symbols =
+      static_cast<Symbol*>(arena->New(texts.size() * sizeof(Symbol)));
+  symbol_table->InternBatch(texts, symbols);
+  return ArenaSlice<Symbol>(texts.size(), symbols);
+}
+
+/// \brief Specialization for storing relocatable slices of Symbols.
+template <>
+class RelocatableArenaSlice<Symbol> {
+ public:
+  RelocatableArenaSlice(size_t length, const Symbol* contents)
+      : length_(length), contents_(contents) {}
+  RelocatableArenaSlice() {}
+  /// \brief Copies the symbols in `slice` into `arena`.
+  static RelocatableArenaSlice Copy(Arena* arena,
+                                    const ArenaSlice<Symbol>& slice) {
+    auto* contents =
+        static_cast<Symbol*>(arena->New(slice.size() * sizeof(Symbol)));
+    for (size_t i = 0; i < slice.size(); ++i) {
+      contents[i] = slice[i];
+    }
+    return RelocatableArenaSlice(slice.size(), contents);
+  }
+  Symbol operator[](size_t index) const { return contents_.get()[index]; }
+  size_t size() const { return length_; }
+
+ private:
+  size_t length_ = 0;
+  ArenaRef<Symbol> contents_;
+};
+
+/// \brief Specialization for storing relocatable options of Symbols. These
+/// don't refer to any other memory, so this is the same as
+/// `ArenaOption<Symbol>`.
+template <>
+class RelocatableArenaOption<Symbol> {
+ public:
+  RelocatableArenaOption(bool is_some, Symbol content)
+      : is_some_(is_some), content_(content) {}
+  RelocatableArenaOption(const ArenaOption<Symbol>& option)
+      : is_some_(option.is_some()), content_(option.get()) {}
+  bool is_some() const { return is_some_; }
+  Symbol get() const { return content_; }
+
+ private:
+  bool is_some_;
+  Symbol content_;
+};
 }  // namespace anodyne
 
 #endif  // ANODYNE_BASE_SYMBOL_TABLE_H_
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks interning the identifiers in a minified JavaScript bundle.
+//
+// Set SYMBOL_TABLE_BENCHMARK_JS to the path of a bundle to use its
+// identifiers. Otherwise, a synthetic bundle with the same flavor (many
+// short mangled locals, fewer long property and API names) is generated.
+
+#include "anodyne/base/symbol_table.h"
+
+#include "benchmark/benchmark.h"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace anodyne {
+namespace {
+
+/// \return whether `c` can start a JavaScript identifier.
+bool IsIdentStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         c == '$';
+}
+
+/// \return whether `c` can continue a JavaScript identifier.
+bool IsIdentPart(char c) { return IsIdentStart(c) || (c >= '0' && c <= '9'); }
+
+/// \brief Splits the identifiers out of `text`. This ignores strings and
+/// comments, which is close enough for minified code.
+std::vector<std::string> Identifiers(const std::string& text) {
+  std::vector<std::string> idents;
+  for (size_t i = 0; i < text.size();) {
+    if (!IsIdentStart(text[i])) {
+      // Skip numbers (like `1e3`) along with other non-identifiers.
+      do {
+        ++i;
+      } while (i < text.size() && IsIdentPart(text[i]) &&
+               !IsIdentStart(text[i - 1]));
+      continue;
+    }
+    size_t start = i;
+    while (i < text.size() && IsIdentPart(text[i])) {
+      ++i;
+    }
+    idents.push_back(text.substr(start, i - start));
+  }
+  return idents;
+}
+
+/// \return the identifiers in a synthetic minified bundle.
+std::vector<std::string> SyntheticIdentifiers() {
+  constexpr size_t kTokens = 1 << 20;
+  static const char* const kNames[] = {
+      "prototype", "length",       "createElement", "addEventListener",
+      "exports",   "require",      "undefined",     "function",
+      "return",    "this",         "default",       "Object",
+      "apply",     "call",         "push",          "hasOwnProperty",
+      "then",      "defineProperty", "document",    "window"};
+  const char kAlphabet[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_$";
+  std::mt19937 random(42);
+  // Mangled names are short and mostly reused; scale the name space so
+  // that roughly one token in ten is new.
+  std::geometric_distribution<int> length(0.6);
+  std::uniform_int_distribution<size_t> letter(0, sizeof(kAlphabet) - 2);
+  std::uniform_int_distribution<int> kind(0, 9);
+  std::uniform_int_distribution<size_t> name(
+      0, sizeof(kNames) / sizeof(kNames[0]) - 1);
+  std::vector<std::string> idents;
+  idents.reserve(kTokens);
+  for (size_t i = 0; i < kTokens; ++i) {
+    if (kind(random) < 2) {
+      idents.push_back(kNames[name(random)]);
+      continue;
+    }
+    std::string ident;
+    for (int c = length(random) + 1; c > 0; --c) {
+      ident.push_back(kAlphabet[letter(random)]);
+    }
+    idents.push_back(ident);
+  }
+  return idents;
+}
+
+/// \return the identifiers to intern, loading them once.
+const std::vector<std::string>& BundleIdentifiers() {
+  static const auto* idents = [] {
+    if (const char* path = getenv("SYMBOL_TABLE_BENCHMARK_JS")) {
+      std::ifstream in(path);
+      std::stringstream text;
+      text << in.rdbuf();
+      return new std::vector<std::string>(Identifiers(text.str()));
+    }
+    return new std::vector<std::string>(SyntheticIdentifiers());
+  }();
+  return *idents;
+}
+
+/// Interning a bundle into a fresh table (a mix of misses and hits).
+void BM_InternBundle(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  for (auto _ : state) {
+    SymbolTable table;
+    for (const auto& ident : idents) {
+      benchmark::DoNotOptimize(table.Intern(ident));
+    }
+    state.counters["symbols"] = table.symbol_count();
+  }
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_InternBundle);
+
+/// Interning a bundle into a table that already has all of its symbols.
+void BM_InternBundleHits(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  SymbolTable table;
+  for (const auto& ident : idents) {
+    table.Intern(ident);
+  }
+  for (auto _ : state) {
+    for (const auto& ident : idents) {
+      benchmark::DoNotOptimize(table.Intern(ident));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_InternBundleHits);
+
+/// `BM_InternBundle`, but with the bundle's symbols in a base image.
+void BM_InternBundleFromImage(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  std::string path = "/tmp/symbol_table_benchmark.image";
+  {
+    SymbolTable table;
+    for (const auto& ident : idents) {
+      table.Intern(ident);
+    }
+    if (!table.WriteImage(path)) {
+      state.SkipWithError("couldn't write image");
+      return;
+    }
+  }
+  for (auto _ : state) {
+    SymbolTable table;
+    table.OpenImage(path);
+    for (const auto& ident : idents) {
+      benchmark::DoNotOptimize(table.Intern(ident));
+    }
+  }
+  unlink(path.c_str());
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_InternBundleFromImage);
+
+/// Making a table, which seeds it with the well-known symbols.
+void BM_NewSymbolTable(benchmark::State& state) {
+  for (auto _ : state) {
+    SymbolTable table;
+    benchmark::DoNotOptimize(table.symbol_count());
+  }
+}
+BENCHMARK(BM_NewSymbolTable);
+
+/// Picking out the well-known identifiers in a bundle with the perfect hash.
+void BM_FindWellKnownBundle(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  for (auto _ : state) {
+    size_t found = 0;
+    for (const auto& ident : idents) {
+      found += well_known::Find(ident) != well_known::kCount;
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_FindWellKnownBundle);
+
+/// \return views of `BundleIdentifiers()`.
+const std::vector<absl::string_view>& BundleIdentifierViews() {
+  static const auto* views = new std::vector<absl::string_view>(
+      BundleIdentifiers().begin(), BundleIdentifiers().end());
+  return *views;
+}
+
+/// `BM_InternBundle` using `InternBatch`.
+void BM_InternBatchBundle(benchmark::State& state) {
+  const auto& views = BundleIdentifierViews();
+  std::vector<Symbol> symbols(views.size());
+  for (auto _ : state) {
+    SymbolTable table;
+    table.InternBatch(views, symbols.data());
+    benchmark::DoNotOptimize(symbols.data());
+  }
+  state.SetItemsProcessed(state.iterations() * views.size());
+}
+BENCHMARK(BM_InternBatchBundle);
+
+/// `BM_InternBundleHits` using `InternBatch`.
+void BM_InternBatchBundleHits(benchmark::State& state) {
+  const auto& views = BundleIdentifierViews();
+  std::vector<Symbol> symbols(views.size());
+  SymbolTable table;
+  table.InternBatch(views, symbols.data());
+  for (auto _ : state) {
+    table.InternBatch(views, symbols.data());
+    benchmark::DoNotOptimize(symbols.data());
+  }
+  state.SetItemsProcessed(state.iterations() * views.size());
+}
+BENCHMARK(BM_InternBatchBundleHits);
+
+/// Interning a bundle from several threads at once into a shared concurrent
+/// table that already has all of its symbols.
+void BM_ConcurrentInternBundleHits(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  static SymbolTable* table = [&idents] {
+    SymbolTable::Options options;
+    options.concurrent = true;
+    auto* table = new SymbolTable(options);
+    for (const auto& ident : idents) {
+      table->Intern(ident);
+    }
+    return table;
+  }();
+  for (auto _ : state) {
+    for (const auto& ident : idents) {
+      benchmark::DoNotOptimize(table->Intern(ident));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_ConcurrentInternBundleHits)->ThreadRange(1, 8)->UseRealTime();
+
+/// Generating symbols from several threads at once.
+void BM_ConcurrentGensym(benchmark::State& state) {
+  static SymbolTable* table = [] {
+    SymbolTable::Options options;
+    options.concurrent = true;
+    return new SymbolTable(options);
+  }();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->Gensym());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentGensym)->ThreadRange(1, 8)->UseRealTime();
+
+/// The previous `SymbolTable` implementation, for comparison.
+class StringMapSymbolTable {
+ public:
+  Symbol Intern(absl::string_view text) {
+    const auto it = symbol_map_.find(std::string(text));
+    if (it != symbol_map_.end()) {
+      return it->second;
+    }
+    symbol_map_[std::string(text)] = static_cast<Symbol>(symbol_text_.size());
+    symbol_text_.push_back(std::string(text));
+    return symbol_text_.size() - 1;
+  }
+
+ private:
+  std::unordered_map<std::string, Symbol> symbol_map_;
+  std::vector<std::string> symbol_text_;
+};
+
+void BM_StringMapInternBundle(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  for (auto _ : state) {
+    StringMapSymbolTable table;
+    for (const auto& ident : idents) {
+      benchmark::DoNotOptimize(table.Intern(ident));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_StringMapInternBundle);
+
+void BM_StringMapInternBundleHits(benchmark::State& state) {
+  const auto& idents = BundleIdentifiers();
+  StringMapSymbolTable table;
+  for (const auto& ident : idents) {
+    table.Intern(ident);
+  }
+  for (auto _ : state) {
+    for (const auto& ident : idents) {
+      benchmark::DoNotOptimize(table.Intern(ident));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * idents.size());
+}
+BENCHMARK(BM_StringMapInternBundleHits);
+
+}  // anonymous namespace
+}  // namespace anodyne
@@ -18,6 +18,13 @@
 #include "absl/strings/str_cat.h"
 #include "gtest/gtest.h"
 
+#include <stdio.h>
+#include <unistd.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
 namespace anodyne {
 namespace {
 
@@ -36,5 +43,219 @@ TEST(SymbolTable, Interns) {
   EXPECT_FALSE(table.is_gensym(one));
 }
 
+TEST(SymbolTable, InternsManySymbols) {
+  SymbolTable table;
+  std::vector<Symbol> symbols;
+  for (int i = 0; i < 10000; ++i) {
+    symbols.push_back(table.Intern(absl::StrCat("symbol", i)));
+  }
+  EXPECT_EQ(well_known::kCount + 10000, table.symbol_count());
+  Symbol empty = table.Intern("");
+  EXPECT_EQ("", table.Text(empty));
+  EXPECT_EQ(empty, table.Intern(absl::string_view()));
+  for (int i = 0; i < 10000; ++i) {
+    std::string text = absl::StrCat("symbol", i);
+    EXPECT_EQ(symbols[i], table.Intern(text));
+    EXPECT_EQ(text, table.Text(symbols[i]));
+  }
+}
+
+TEST(SymbolTable, SeedsWellKnownSymbols) {
+  static_assert(well_known::Find("function") == well_known::kFunction,
+                "well-known symbols should be found at compile time");
+  EXPECT_EQ(well_known::kCount, well_known::Find("functio"));
+  EXPECT_EQ(well_known::kCount, well_known::Find("Function2"));
+  EXPECT_EQ(well_known::kCount, well_known::Find(""));
+  for (bool concurrent : {false, true}) {
+    SymbolTable::Options options;
+    options.concurrent = concurrent;
+    SymbolTable table(options);
+    EXPECT_EQ(well_known::kCount, table.symbol_count());
+    for (Symbol symbol = 0; symbol < well_known::kCount; ++symbol) {
+      absl::string_view text = well_known::Text(symbol);
+      EXPECT_EQ(symbol, well_known::Find(text));
+      EXPECT_EQ(symbol, table.Intern(text));
+      EXPECT_EQ(text, table.Text(symbol));
+    }
+    EXPECT_EQ(well_known::kPrototype, table.Intern("prototype"));
+    EXPECT_EQ(well_known::kCount, table.Intern("not_well_known"));
+  }
+}
+
+TEST(SymbolTable, InternBatch) {
+  for (bool concurrent : {false, true}) {
+    SymbolTable::Options options;
+    options.concurrent = concurrent;
+    SymbolTable table(options);
+    Symbol existing = table.Intern("symbol7");
+    std::vector<std::string> texts;
+    for (int i = 0; i < 100; ++i) {
+      texts.push_back(absl::StrCat("symbol", i % 40));
+    }
+    std::vector<absl::string_view> views(texts.begin(), texts.end());
+    std::vector<Symbol> symbols(views.size());
+    table.InternBatch(views, symbols.data());
+    EXPECT_EQ(well_known::kCount + 40, table.symbol_count());
+    EXPECT_EQ(existing, symbols[7]);
+    for (size_t i = 0; i < texts.size(); ++i) {
+      EXPECT_EQ(texts[i], table.Text(symbols[i]));
+      EXPECT_EQ(symbols[i % 40], symbols[i]);
+    }
+    Arena arena;
+    auto slice = InternSlice(&table, &arena, {"symbol3", "new"});
+    ASSERT_EQ(2, slice.size());
+    EXPECT_EQ(symbols[3], slice[0]);
+    EXPECT_EQ("new", table.Text(slice[1]));
+  }
+}
+
+TEST(SymbolTable, OpensImages) {
+  std::string path = ::testing::TempDir() + "/symbols.image";
+  std::vector<Symbol> symbols;
+  {
+    SymbolTable table;
+    for (int i = 0; i < 1000; ++i) {
+      symbols.push_back(table.Intern(absl::StrCat("symbol", i)));
+    }
+    symbols.push_back(table.Intern(""));
+    ASSERT_TRUE(table.WriteImage(path));
+  }
+  for (bool concurrent : {false, true}) {
+    SymbolTable::Options options;
+    options.concurrent = concurrent;
+    SymbolTable table(options);
+    ASSERT_TRUE(table.OpenImage(path));
+    EXPECT_EQ(well_known::kCount + 1001, table.base_count());
+    EXPECT_EQ(well_known::kCount + 1001, table.symbol_count());
+    EXPECT_EQ(well_known::kThis, table.Intern("this"));
+    for (int i = 0; i < 1000; ++i) {
+      EXPECT_EQ(symbols[i], table.Intern(absl::StrCat("symbol", i)));
+      EXPECT_EQ(absl::StrCat("symbol", i), table.Text(symbols[i]));
+    }
+    EXPECT_EQ(symbols[1000], table.Intern(""));
+    Symbol overlay = table.Intern("overlay");
+    EXPECT_EQ(well_known::kCount + 1001, overlay);
+    EXPECT_EQ("overlay", table.Text(overlay));
+    std::vector<absl::string_view> texts = {"symbol3", "overlay", "new"};
+    std::vector<Symbol> batch(texts.size());
+    table.InternBatch(texts, batch.data());
+    EXPECT_EQ(symbols[3], batch[0]);
+    EXPECT_EQ(overlay, batch[1]);
+    EXPECT_EQ("new", table.Text(batch[2]));
+  }
+}
+
+TEST(SymbolTable, RejectsBadImages) {
+  std::string path = ::testing::TempDir() + "/bad.image";
+  {
+    SymbolTable table;
+    table.Intern("a");
+    ASSERT_TRUE(table.WriteImage(path));
+  }
+  SymbolTable used;
+  used.Intern("b");
+  EXPECT_FALSE(used.OpenImage(path));
+  SymbolTable fresh;
+  EXPECT_FALSE(fresh.OpenImage(path + ".missing"));
+  {
+    FILE* file = fopen(path.c_str(), "r+b");
+    ASSERT_NE(nullptr, file);
+    fseek(file, 0, SEEK_END);
+    ASSERT_EQ(0, ftruncate(fileno(file), ftell(file) - 1));
+    fclose(file);
+  }
+  EXPECT_FALSE(fresh.OpenImage(path));
+  EXPECT_EQ(0, fresh.base_count());
+  EXPECT_EQ(well_known::kCount, fresh.Intern("a"));
+}
+
+TEST(SymbolTable, WithoutWellKnownSymbols) {
+  SymbolTable::Options options;
+  options.well_known_symbols = false;
+  SymbolTable table(options);
+  EXPECT_EQ(0, table.symbol_count());
+  Symbol symbol;
+  EXPECT_FALSE(table.Find(well_known::Text(0), &symbol));
+  EXPECT_EQ(0, table.Intern("a"));
+  EXPECT_EQ(1, table.Intern(well_known::Text(0)));
+  EXPECT_EQ("a", table.Text(0));
+}
+
+TEST(SymbolTable, ConcurrentGensymsAcrossTables) {
+  SymbolTable::Options options;
+  options.concurrent = true;
+  SymbolTable first(options);
+  SymbolTable second(options);
+  Symbol first_base = first.gensym_limit();
+  Symbol second_base = second.gensym_limit();
+  constexpr int kGensyms = 4096;
+  Symbol last_first = 0;
+  Symbol last_second = 0;
+  for (int i = 0; i < kGensyms; ++i) {
+    Symbol a = first.Gensym();
+    Symbol b = second.Gensym();
+    ASSERT_TRUE(SymbolTable::is_gensym(a));
+    ASSERT_TRUE(SymbolTable::is_gensym(b));
+    if (i != 0) {
+      ASSERT_GT(a, last_first);
+      ASSERT_GT(b, last_second);
+    }
+    last_first = a;
+    last_second = b;
+  }
+  // Switching tables doesn't throw away the rest of a thread's range.
+  EXPECT_GE(first_base + 2 * kGensyms, first.gensym_limit());
+  EXPECT_GE(second_base + 2 * kGensyms, second.gensym_limit());
+}
+
+TEST(SymbolTable, ConcurrentInternIsDense) {
+  SymbolTable::Options options;
+  options.concurrent = true;
+  SymbolTable table(options);
+  constexpr int kThreads = 8;
+  constexpr int kSymbols = 5000;
+  std::vector<std::vector<Symbol>> interned(kThreads);
+  std::vector<std::vector<Symbol>> gensyms(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      // Every thread interns the same strings, in different orders.
+      for (int i = 0; i < kSymbols; ++i) {
+        int n = (i * (t + 1)) % kSymbols;
+        interned[t].push_back(table.Intern(absl::StrCat("symbol", n)));
+        gensyms[t].push_back(table.Gensym());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(well_known::kCount + kSymbols, table.symbol_count());
+  std::vector<bool> seen(kSymbols);
+  for (int t = 0; t < kThreads; ++t) {
+    for (int i = 0; i < kSymbols; ++i) {
+      Symbol symbol = interned[t][i];
+      ASSERT_GE(symbol, well_known::kCount);
+      ASSERT_LT(symbol, well_known::kCount + kSymbols);
+      seen[symbol - well_known::kCount] = true;
+      int n = (i * (t + 1)) % kSymbols;
+      EXPECT_EQ(absl::StrCat("symbol", n), table.Text(symbol));
+      EXPECT_EQ(symbol, table.Intern(absl::StrCat("symbol", n)));
+    }
+  }
+  for (int i = 0; i < kSymbols; ++i) {
+    EXPECT_TRUE(seen[i]);
+  }
+  std::set<Symbol> unique_gensyms;
+  for (const auto& thread_gensyms : gensyms) {
+    for (Symbol gensym : thread_gensyms) {
+      EXPECT_TRUE(table.is_gensym(gensym));
+      EXPECT_LT(gensym, table.gensym_limit());
+      unique_gensyms.insert(gensym);
+    }
+  }
+  EXPECT_EQ(kThreads * kSymbols, unique_gensyms.size());
+}
+
 }  // anonymous namespace
 }  // namespace anodyne
@@ -0,0 +1,45 @@
+# Copyright 2018 Google Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+def symbol_gen(name, src = "", out_prefix = "", namespace = ""):
+    """Generate constexpr symbols and a perfect hash table over their text.
+
+    Args:
+      name: The name of the rule.
+      src: A list of symbols, one per line, each optionally followed by the
+           name of its constant. Lines starting with # are ignored.
+      out_prefix: The generated header prefix (to which .h will be appended).
+      namespace: The C++ namespace to emit the symbols into.
+    """
+    if out_prefix == "":
+        fail("out_prefix must not be empty")
+    if src == "":
+        fail("src must not be empty")
+    if namespace == "":
+        fail("namespace must not be empty")
+    native.genrule(
+        name = name + "_gen",
+        srcs = [src],
+        outs = [out_prefix + ".h"],
+        tools = ["//anodyne/tools:symbol_gen"],
+        cmd = "./$(location //anodyne/tools:symbol_gen) $(@D)/%s %s $(location %s)" % (out_prefix, namespace, src),
+    )
+    native.cc_library(
+        name = name,
+        hdrs = [out_prefix + ".h"],
+        deps = [
+            "//anodyne/base:perfect_hash",
+            "@com_google_absl//absl/strings",
+        ],
+    )
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Generates a header of constexpr symbols and a perfect hash table over
+// their text. See symbol_gen.bzl.
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "anodyne/base/fs.h"
+#include "anodyne/base/perfect_hash.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+/// \brief A symbol to emit.
+struct Entry {
+  /// The symbol's text.
+  std::string text;
+  /// The name of the constant for the symbol.
+  std::string name;
+};
+
+/// \return the default constant name for `text`, or the empty string if
+/// `text` doesn't make a valid one.
+std::string NameFor(absl::string_view text) {
+  if (text.empty() || !absl::ascii_isalpha(text[0])) {
+    return "";
+  }
+  for (char c : text) {
+    if (!absl::ascii_isalnum(c) && c != '_') {
+      return "";
+    }
+  }
+  std::string name = "k";
+  name.push_back(absl::ascii_toupper(text[0]));
+  name.append(text.data() + 1, text.size() - 1);
+  return name;
+}
+
+/// \brief Parses a symbol list: one symbol per line, optionally followed by
+/// the name of its constant. Blank lines and lines starting with # are
+/// ignored.
+/// \return false on failure.
+bool ParseEntries(absl::string_view source, std::vector<Entry>* entries) {
+  std::set<std::string> texts;
+  std::set<std::string> names;
+  int line_number = 0;
+  for (absl::string_view line : absl::StrSplit(source, '\n')) {
+    ++line_number;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    if (fields.empty()) {
+      continue;
+    }
+    if (fields.size() > 2) {
+      ::fprintf(stderr, "line %d: expected a symbol and an optional name\n",
+                line_number);
+      return false;
+    }
+    Entry entry;
+    entry.text = std::string(fields[0]);
+    entry.name =
+        fields.size() == 2 ? std::string(fields[1]) : NameFor(fields[0]);
+    if (entry.name.empty()) {
+      ::fprintf(stderr, "line %d: %s needs an explicit name\n", line_number,
+                entry.text.c_str());
+      return false;
+    }
+    if (!texts.insert(entry.text).second || !names.insert(entry.name).second) {
+      ::fprintf(stderr, "line %d: %s (%s) is a duplicate\n", line_number,
+                entry.text.c_str(), entry.name.c_str());
+      return false;
+    }
+    entries->push_back(entry);
+  }
+  return true;
+}
+
+/// \brief Finds a seed and table size for which `perfect_hash::Hash` maps
+/// each of `entries` to a different slot.
+/// \param slots set to the table, with `entries.size()` marking empty slots.
+void FindPerfectHash(const std::vector<Entry>& entries, uint32_t* seed,
+                     std::vector<size_t>* slots) {
+  size_t size = 1;
+  while (size < entries.size() * 2) {
+    size *= 2;
+  }
+  for (;; size *= 2) {
+    for (*seed = 0; *seed < 0x10000; ++*seed) {
+      slots->assign(size, entries.size());
+      bool ok = true;
+      for (size_t i = 0; ok && i < entries.size(); ++i) {
+        const auto& text = entries[i].text;
+        size_t slot =
+            anodyne::perfect_hash::Hash(text.data(), text.size(), *seed) &
+            (size - 1);
+        ok = (*slots)[slot] == entries.size();
+        (*slots)[slot] = i;
+      }
+      if (ok) {
+        return;
+      }
+    }
+  }
+}
+
+/// \return `text` as a C++ string literal.
+std::string Quote(absl::string_view text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted.push_back('\\');
+    }
+    quoted.push_back(c);
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+/// \brief Writes the header for `entries` in namespace `space` to `out`.
+void EmitHeader(const std::vector<Entry>& entries, const std::string& space,
+                const std::string& source_path, FILE* out) {
+  uint32_t seed;
+  std::vector<size_t> slots;
+  FindPerfectHash(entries, &seed, &slots);
+  size_t max_length = 0;
+  for (const auto& entry : entries) {
+    max_length = std::max(max_length, entry.text.size());
+  }
+  std::vector<std::string> namespaces = absl::StrSplit(space, "::");
+  std::string guard;
+  for (const auto& name : namespaces) {
+    guard.append(absl::AsciiStrToUpper(name)).append("_");
+  }
+  guard.append("SYMBOLS_H_");
+  ::fprintf(out, "// Generated by symbol_gen from %s. Do not edit.\n\n",
+            source_path.c_str());
+  ::fprintf(out, "#ifndef %s\n#define %s\n\n", guard.c_str(), guard.c_str());
+  ::fprintf(out, "#include \"absl/strings/string_view.h\"\n");
+  ::fprintf(out, "#include \"anodyne/base/perfect_hash.h\"\n\n");
+  ::fprintf(out, "#include <cstddef>\n#include <cstdint>\n\n");
+  for (const auto& name : namespaces) {
+    ::fprintf(out, "namespace %s {\n", name.c_str());
+  }
+  ::fprintf(out, "\n");
+  for (size_t i = 0; i < entries.size(); ++i) {
+    ::fprintf(out, "constexpr uint32_t %s = %zu;\n", entries[i].name.c_str(),
+              i);
+  }
+  ::fprintf(out, "\n/// The number of symbols.\n");
+  ::fprintf(out, "constexpr uint32_t kCount = %zu;\n", entries.size());
+  ::fprintf(out, "/// The length of the longest symbol's text.\n");
+  ::fprintf(out, "constexpr size_t kMaxLength = %zu;\n\n", max_length);
+  ::fprintf(out, "namespace internal {\n");
+  ::fprintf(out, "constexpr uint32_t kSeed = %u;\n", seed);
+  ::fprintf(out, "constexpr uint32_t kSlotMask = %zu;\n", slots.size() - 1);
+  // Slots hold symbols, so use the smallest type that fits them.
+  const char* slot_type = entries.size() < 0x100
+                              ? "uint8_t"
+                              : entries.size() < 0x10000 ? "uint16_t"
+                                                         : "uint32_t";
+  ::fprintf(out, "constexpr %s kSlots[] = {", slot_type);
+  for (size_t i = 0; i < slots.size(); ++i) {
+    ::fprintf(out, "%s%zu", i == 0 ? "" : ", ", slots[i]);
+  }
+  ::fprintf(out, "};\n");
+  ::fprintf(out, "constexpr const char* kTexts[] = {");
+  for (size_t i = 0; i < entries.size(); ++i) {
+    ::fprintf(out, "%s%s", i == 0 ? "" : ", ",
+              Quote(entries[i].text).c_str());
+  }
+  ::fprintf(out, "};\n");
+  ::fprintf(out, "constexpr size_t kSizes[] = {");
+  for (size_t i = 0; i < entries.size(); ++i) {
+    ::fprintf(out, "%s%zu", i == 0 ? "" : ", ", entries[i].text.size());
+  }
+  ::fprintf(out, "};\n");
+  ::fprintf(out,
+            "constexpr uint32_t Check(absl::string_view text, uint32_t "
+            "symbol) {\n"
+            "  return symbol < kCount && kSizes[symbol] == text.size() &&\n"
+            "                 ::anodyne::perfect_hash::Equal(\n"
+            "                     kTexts[symbol], text.data(), text.size())\n"
+            "             ? symbol\n"
+            "             : kCount;\n"
+            "}\n");
+  ::fprintf(out, "}  // namespace internal\n\n");
+  ::fprintf(out,
+            "/// \\return the text of `symbol`, which must be less than "
+            "`kCount`.\n"
+            "constexpr absl::string_view Text(uint32_t symbol) {\n"
+            "  return absl::string_view(internal::kTexts[symbol],\n"
+            "                           internal::kSizes[symbol]);\n"
+            "}\n\n");
+  ::fprintf(out,
+            "/// \\return the symbol with text `text`, or `kCount` if there "
+            "isn't one.\n"
+            "constexpr uint32_t Find(absl::string_view text) {\n"
+            "  return text.size() > kMaxLength\n"
+            "             ? kCount\n"
+            "             : internal::Check(\n"
+            "                   text, internal::kSlots[::anodyne::"
+            "perfect_hash::Hash(\n"
+            "                             text.data(), text.size(), "
+            "internal::kSeed) &\n"
+            "                         internal::kSlotMask]);\n"
+            "}\n\n");
+  for (auto name = namespaces.rbegin(); name != namespaces.rend(); ++name) {
+    ::fprintf(out, "}  // namespace %s\n", name->c_str());
+  }
+  ::fprintf(out, "\n#endif  // %s\n", guard.c_str());
+}
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    ::fprintf(stderr, "usage: %s output/prefix namespace symbols.txt\n",
+              argv[0]);
+    return 1;
+  }
+  anodyne::RealFileSystem fs;
+  auto source = fs.GetFileContent(argv[3]);
+  if (!source) {
+    ::fprintf(stderr, "couldn't get file content: %s\n",
+              source.status().ToString().c_str());
+    return 1;
+  }
+  std::vector<Entry> entries;
+  if (!ParseEntries(*source, &entries)) {
+    return 1;
+  }
+  if (entries.empty()) {
+    ::fprintf(stderr, "%s has no symbols\n", argv[3]);
+    return 1;
+  }
+  std::string h_name = argv[1];
+  h_name.append(".h");
+  FILE* h = ::fopen(h_name.c_str(), "wb");
+  if (!h) {
+    ::fprintf(stderr, "can't open %s for writing\n", h_name.c_str());
+    return 1;
+  }
+  EmitHeader(entries, argv[2], argv[3], h);
+  if (::fclose(h)) {
+    ::fprintf(stderr, "can't close %s\n", h_name.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures building and walking large tt-generated trees.
+
+#include "anodyne/tools/testdata/test_defs.tt.h"
+#include "benchmark/benchmark.h"
+
+namespace {
+
+/// \brief Builds a complete binary tree of `App`s of height `depth` whose
+/// leaves alternate between `Lam`s and `Id`s.
+const test::exp* BuildTree(int depth, anodyne::Symbol symbol) {
+  if (depth == 0) {
+    return (symbol & 1) ? test::Lam(symbol, test::Id(symbol))
+                        : test::Id(symbol);
+  }
+  return test::App(BuildTree(depth - 1, symbol),
+                   BuildTree(depth - 1, symbol + 1));
+}
+
+/// \brief Counts the nodes in `e`, touching every node.
+size_t CountNodes(const test::exp* e) {
+  switch (e->tag()) {
+    case test::exp::Tag::kApp:
+      return 1 + CountNodes(e->AsApp()->m_0_) + CountNodes(e->AsApp()->m_1_);
+    case test::exp::Tag::kLam:
+      return 1 + CountNodes(e->AsLam()->m_1_);
+    default:
+      return 1;
+  }
+}
+
+/// \brief Builds and walks a tree of height `state.range(0)` in a fresh
+/// `Context` configured with `options`.
+void BuildAndWalk(benchmark::State& state,
+                  const anodyne::Context::Options& options) {
+  const int depth = state.range(0);
+  size_t nodes = 0;
+  for (auto _ : state) {
+    anodyne::Context context(options);
+    anodyne::ContextBinding binding(&context);
+    const test::exp* tree = BuildTree(depth, 0);
+    nodes = CountNodes(tree);
+    benchmark::DoNotOptimize(nodes);
+  }
+  state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+void BM_HeapArena(benchmark::State& state) {
+  BuildAndWalk(state, anodyne::Context::Options());
+}
+BENCHMARK(BM_HeapArena)->Arg(16)->Arg(20)->Arg(22);
+
+void BM_MmapArena(benchmark::State& state) {
+  anodyne::Context::Options options;
+  options.arena.backend = anodyne::ArenaBackend::kMmap;
+  BuildAndWalk(state, options);
+}
+BENCHMARK(BM_MmapArena)->Arg(16)->Arg(20)->Arg(22);
+
+void BM_MmapArenaHugePages(benchmark::State& state) {
+  anodyne::Context::Options options;
+  options.arena.backend = anodyne::ArenaBackend::kMmap;
+  options.arena.huge_pages = true;
+  BuildAndWalk(state, options);
+}
+BENCHMARK(BM_MmapArenaHugePages)->Arg(16)->Arg(20)->Arg(22);
+
+}  // anonymous namespace
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file checks the copying functions that tt generates.
+
+#include "absl/memory/memory.h"
+#include "anodyne/tools/testdata/test_defs.tt.h"
+#include "gtest/gtest.h"
+
+namespace anodyne {
+namespace {
+
+TEST(TreeCopyTest, PreservesSharing) {
+  Context context;
+  ContextBinding binding(&context);
+  Symbol x = context.symbol_table()->Intern("x");
+  const test::exp* id = test::Id(x);
+  const test::exp* lam = test::Lam(x, id);
+  const test::exp* app = test::App(lam, lam);
+  // Garbage that shouldn't be copied.
+  test::App(id, id);
+  Arena fresh;
+  ArenaCopier copier(&fresh);
+  const test::exp* copy = test::exp::DeepCopy(app, &copier);
+  EXPECT_NE(app, copy);
+  EXPECT_EQ(3, copier.copied_count());
+  const auto* copy_app = copy->AsApp();
+  ASSERT_NE(nullptr, copy_app);
+  EXPECT_EQ(copy_app->m_0_, copy_app->m_1_);
+  const auto* copy_lam = copy_app->m_0_->AsLam();
+  ASSERT_NE(nullptr, copy_lam);
+  EXPECT_NE(lam, copy_app->m_0_);
+  EXPECT_EQ(x, copy_lam->m_0_);
+  ASSERT_NE(nullptr, copy_lam->m_1_->AsId());
+  EXPECT_EQ(x, copy_lam->m_1_->AsId()->m_0_);
+  // Copying again with the same copier reuses the earlier copies.
+  EXPECT_EQ(copy_app->m_0_, test::exp::DeepCopy(lam, &copier));
+  EXPECT_EQ(3, copier.copied_count());
+}
+
+TEST(TreeCopyTest, ChargesCopies) {
+  Context context;
+  ContextBinding binding(&context);
+  Symbol x = context.symbol_table()->Intern("x");
+  const test::exp* id = test::Id(x);
+  const test::exp* app = test::App(id, test::App(id, id));
+  // Garbage that shouldn't be copied.
+  test::App(app, app);
+  Arena::Options options;
+  options.track_accounts = true;
+  Arena fresh(options);
+  ArenaCopier copier(&fresh);
+  test::exp::DeepCopy(app, &copier);
+  ArenaStats stats = fresh.stats();
+  const auto& accounts = stats.accounts;
+  ASSERT_EQ(2, accounts.size());
+  size_t count = 0;
+  for (const auto& account : accounts) {
+    count += account.second.count;
+  }
+  EXPECT_EQ(copier.copied_count(), count);
+  EXPECT_EQ(3, count);
+  EXPECT_EQ(2, accounts.at(&test::UnboxedApp::kArenaAccount).count);
+  EXPECT_EQ(sizeof(test::UnboxedId),
+            accounts.at(&test::UnboxedId::kArenaAccount).bytes);
+}
+
+TEST(TreeCopyTest, ReplaceArena) {
+  Context context;
+  ContextBinding binding(&context);
+  // Deep enough to overflow the stack if copying were recursive.
+  constexpr int kDepth = 1000000;
+  const test::exp* unit = test::Unit(anodyne::unit);
+  const test::exp* e = unit;
+  for (int i = 0; i < kDepth; ++i) {
+    e = test::App(unit, e);
+  }
+  auto fresh = absl::make_unique<Arena>();
+  ArenaCopier copier(fresh.get());
+  e = test::exp::DeepCopy(e, &copier);
+  auto old = context.ReplaceArena(std::move(fresh));
+  old.reset();
+  int depth = 0;
+  while (const auto* app = e->AsApp()) {
+    EXPECT_NE(nullptr, app->m_0_->AsUnit());
+    e = app->m_1_;
+    ++depth;
+  }
+  EXPECT_EQ(kDepth, depth);
+  EXPECT_NE(nullptr, e->AsUnit());
+}
+
+}  // anonymous namespace
+}  // namespace anodyne
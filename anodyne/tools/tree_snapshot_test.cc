@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file checks that relocatable trees survive an ArenaSnapshot.
+
+#include "anodyne/base/arena_snapshot.h"
+#include "anodyne/tools/testdata/test_defs_relocatable.tt.h"
+#include "gtest/gtest.h"
+
+namespace anodyne {
+namespace {
+
+TEST(TreeSnapshotTest, RoundTrip) {
+  std::string path = ::testing::TempDir() + "/trees.snapshot";
+  {
+    Context::Options options;
+    options.arena.backend = ArenaBackend::kMmap;
+    options.arena.mmap_reserve_bytes = 1024 * 1024;
+    Context context(options);
+    ContextBinding binding(&context);
+    Symbol x = context.symbol_table()->Intern("x");
+    const test::exp* e = test::Lam(x, test::Id(x));
+    e = test::App(e, test::Unit(unit));
+    ASSERT_TRUE(ArenaSnapshot::Write(*context.arena(), *context.symbol_table(),
+                                     {e}, path));
+  }
+  Context context;
+  auto snapshot = ArenaSnapshot::Open(path, context.symbol_table());
+  ASSERT_NE(nullptr, snapshot);
+  const auto* app = snapshot->root<test::exp>(0)->AsApp();
+  ASSERT_NE(nullptr, app);
+  const auto* lam = app->m_0_->AsLam();
+  ASSERT_NE(nullptr, lam);
+  EXPECT_EQ("x", context.symbol_table()->Text(lam->m_0_));
+  const auto* id = lam->m_1_->AsId();
+  ASSERT_NE(nullptr, id);
+  EXPECT_EQ(lam->m_0_, id->m_0_);
+  EXPECT_NE(nullptr, app->m_1_->AsUnit());
+}
+
+}  // anonymous namespace
+}  // namespace anodyne
@@ -12,7 +12,7 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
-def tt_library(name, src, out_prefix, builds_json = False):
+def tt_library(name, src, out_prefix, builds_json = False, relocatable = False):
     """Generate C++ datatype definitions from a tt definition.
 
     Args:
@@ -22,12 +22,17 @@ def tt_library(name, src, out_prefix, builds_json = False):
                   appended).
       builds_json: Whether any of the definitions in the .tt require json
                    support.
+      relocatable: Whether to generate trees that can be stored in an
+                   ArenaSnapshot.
     """
+    _flags = ""
+    if relocatable:
+        _flags = "--relocatable "
     native.genrule(
         name = name + "_tt_gen",
         srcs = [src],
         tools = ["//anodyne/tools:tt"],
-        cmd = "./$(location //anodyne/tools:tt) $(@D)/%s $(location %s)" % (out_prefix, src),
+        cmd = "./$(location //anodyne/tools:tt) %s$(@D)/%s $(location %s)" % (_flags, out_prefix, src),
         outs = [out_prefix + ".cc", out_prefix + ".h"],
     )
     _json_deps = []
@@ -41,6 +46,7 @@ def tt_library(name, src, out_prefix, builds_json = False):
         includes = [out_header],
         deps = [
             "//anodyne/base",
+            "//anodyne/base:arena_copier",
             "//anodyne/base:source",
             "//anodyne/base:symbol_table",
             "//anodyne/base:context",
@@ -21,6 +21,8 @@
 //
 // `tt output-prefix input.tt` reads tree definitions from `input.tt` and
 //     writes implementation files `output-prefix.cc` and `output-prefix.h`
+// `tt --relocatable output-prefix input.tt` does the same, but generates
+//     trees that can be stored in an `anodyne::ArenaSnapshot`
 // `tt output-prefix input.cc` reads pattern definitions from `input.cc` and
 //     writes the implementation file `output-prefix.matchers.h`
 
@@ -57,7 +59,7 @@ class AutoUnlink {
 /// to name output.
 int BuildTreeDefs(const anodyne::Source& source,
                   const anodyne::File* source_content,
-                  absl::string_view dest_file_prefix) {
+                  absl::string_view dest_file_prefix, bool relocatable) {
   anodyne::TtParser parser;
   if (!parser.ParseFile(source_content, false)) {
     fprintf(stderr, "could not parse %s as tt source\n",
@@ -79,7 +81,7 @@ int BuildTreeDefs(const anodyne::Source& source,
   }
   AutoUnlink unlink_h(h_path);
   if (!anodyne::TtGenerator::GenerateCode(parser, source, h_path, h_out,
-                                          cc_out)) {
+                                          cc_out, relocatable)) {
     return 1;
   }
   if (fclose(cc_out) != 0) {
@@ -127,8 +129,14 @@ int BuildMatchers(const anodyne::Source& source,
 }  // anonymous namespace
 
 int main(int argc, char** argv) {
+  bool relocatable = false;
+  if (argc == 4 && absl::string_view(argv[1]) == "--relocatable") {
+    relocatable = true;
+    --argc;
+    ++argv;
+  }
   if (argc != 3) {
-    fprintf(stderr, R"(usage: %s dest-file-prefix defs.tt
+    fprintf(stderr, R"(usage: %s [--relocatable] dest-file-prefix defs.tt
          Writes to dest-file-prefix{.cc, .h}
       %s dest-file-prefix patterns.cc
          Writes to dest-file-prefix{.matchers.h}
@@ -155,7 +163,8 @@ int main(int argc, char** argv) {
     return 1;
   }
   if (source_file.rfind(".tt") != absl::string_view::npos) {
-    return BuildTreeDefs(source, source_content, dest_file_prefix);
+    return BuildTreeDefs(source, source_content, dest_file_prefix,
+                         relocatable);
   }
   return BuildMatchers(source, source_content, dest_file_prefix);
 }
@@ -73,6 +73,8 @@ bool TtGenerator::GeneratePreamble() {
   fprintf(h_, "#define %s\n", HeaderGuardFor(h_relative_path_).c_str());
   fprintf(h_, "#include \"%s\"\n",
           LocalPathFor("anodyne/base/arena.h").c_str());
+  fprintf(h_, "#include \"%s\"\n",
+          LocalPathFor("anodyne/base/arena_copier.h").c_str());
   fprintf(h_, "#include \"%s\"\n",
           LocalPathFor("anodyne/base/context.h").c_str());
   fprintf(h_, "#include \"%s\"\n",
@@ -127,6 +129,13 @@ bool TtGenerator::Generate() {
       }
     }
   }
+  // Copying implementation.
+  for (const auto& datatype : parser_.datatypes()) {
+    Namespace ns(datatype.second.qualifiers, cc_);
+    if (!GenerateCopier(datatype.second)) {
+      return false;
+    }
+  }
   if (!GeneratePostamble()) {
     return false;
   }
@@ -291,11 +300,25 @@ bool TtGenerator::GenerateDatatypeRep(const TtDatatype& datatype) {
             ctor.ident.c_str());
   }
   fprintf(h_, "  inline void Dump(absl::string_view prefix) const;\n");
+  fprintf(h_,
+          "  static const %s* DeepCopy(const %s* from, "
+          "::anodyne::ArenaCopier* copier);\n",
+          datatype.unqualified_ident.c_str(),
+          datatype.unqualified_ident.c_str());
   fprintf(h_, " protected:\n");
   fprintf(h_, "  %s(Tag t) : tag_(t) { }\n",
           datatype.unqualified_ident.c_str());
   DeleteBadCtors(datatype.unqualified_ident, h_);
   fprintf(h_, " private:\n");
+  fprintf(h_, "  friend class ::anodyne::ArenaCopier;\n");
+  fprintf(h_,
+          "  static const %s* Evacuate(const %s* from, "
+          "::anodyne::ArenaCopier* copier);\n",
+          datatype.unqualified_ident.c_str(),
+          datatype.unqualified_ident.c_str());
+  fprintf(h_,
+          "  static void Scavenge(const void* node, "
+          "::anodyne::ArenaCopier* copier);\n");
   fprintf(h_, "  Tag tag_;\n");
   fprintf(h_, "};\n");
   return true;
@@ -324,6 +347,11 @@ bool TtGenerator::GenerateCtorRep(const TtDatatype& datatype,
   }
   fprintf(h_, " {}\n");
   DeleteBadCtors(("Unboxed" + constructor.ident).c_str(), h_);
+  // Allocations of this constructor are charged to this account.
+  fprintf(h_,
+          "  static constexpr ::anodyne::ArenaAccount kArenaAccount{\"%s\", "
+          "\"%s\"};\n",
+          datatype.raw_ident.c_str(), constructor.ident.c_str());
   for (size_t i = 0; i < decomposed_type.size(); ++i) {
     fprintf(h_, "  %s m_%lu_;\n", decomposed_type[i].c_str(), i);
   }
@@ -343,9 +371,11 @@ bool TtGenerator::GenerateCtorRep(const TtDatatype& datatype,
     fprintf(h_, "%s m_%lu", decomposed_type[i].c_str(), i);
   }
   fprintf(h_, ") {\n");
+  fprintf(h_, "  auto* arena = ::anodyne::Context::Current()->arena();\n");
   fprintf(h_,
-          "  return new (::anodyne::Context::Current()->arena()) Unboxed%s(",
-          constructor.ident.c_str());
+          "  arena->Charge(&Unboxed%s::kArenaAccount, sizeof(Unboxed%s));\n",
+          constructor.ident.c_str(), constructor.ident.c_str());
+  fprintf(h_, "  return new (arena) Unboxed%s(", constructor.ident.c_str());
   for (size_t i = 0; i < decomposed_type.size(); ++i) {
     if (i != 0) {
       fprintf(h_, ", ");
@@ -356,6 +386,84 @@ bool TtGenerator::GenerateCtorRep(const TtDatatype& datatype,
   return true;
 }
 
+bool TtGenerator::GenerateCopier(const TtDatatype& datatype) {
+  const char* name = datatype.unqualified_ident.c_str();
+  fprintf(cc_,
+          "const %s* %s::DeepCopy(const %s* from, "
+          "::anodyne::ArenaCopier* copier) {\n",
+          name, name, name);
+  fprintf(cc_, "  const %s* to = copier->Evacuate(from);\n", name);
+  fprintf(cc_, "  copier->Drain();\n");
+  fprintf(cc_, "  return to;\n}\n");
+  // Evacuate makes a shallow copy of a node.
+  fprintf(cc_,
+          "const %s* %s::Evacuate(const %s* from, "
+          "::anodyne::ArenaCopier* copier) {\n",
+          name, name, name);
+  fprintf(cc_, "  if (const void* to = copier->Forwarded(from)) {\n");
+  fprintf(cc_, "    return static_cast<const %s*>(to);\n  }\n", name);
+  fprintf(cc_, "  const %s* to = nullptr;\n", name);
+  fprintf(cc_, "  switch (from->tag()) {\n");
+  for (const auto& ctor : datatype.ctors) {
+    std::vector<Type> decomposed_type;
+    if (!DecomposeCtorType(ctor, &decomposed_type)) {
+      return false;
+    }
+    fprintf(cc_, "    case Tag::k%s: {\n", ctor.ident.c_str());
+    if (!decomposed_type.empty()) {
+      fprintf(cc_, "      const auto* f = from->As%s();\n", ctor.ident.c_str());
+    }
+    fprintf(cc_,
+            "      copier->arena()->Charge(&Unboxed%s::kArenaAccount, "
+            "sizeof(Unboxed%s));\n",
+            ctor.ident.c_str(), ctor.ident.c_str());
+    fprintf(cc_, "      to = new (copier->arena()) Unboxed%s(",
+            ctor.ident.c_str());
+    for (size_t i = 0; i < decomposed_type.size(); ++i) {
+      fprintf(cc_, "%sf->m_%lu_", i == 0 ? "" : ", ", i);
+    }
+    fprintf(cc_, ");\n    } break;\n");
+  }
+  fprintf(cc_, "  }\n");
+  fprintf(cc_, "  copier->Forward(from, to, &Scavenge);\n");
+  fprintf(cc_, "  return to;\n}\n");
+  // Scavenge points the fields of a shallow copy at copies of their own.
+  fprintf(cc_,
+          "void %s::Scavenge(const void* node, "
+          "::anodyne::ArenaCopier* copier) {\n",
+          name);
+  fprintf(cc_, "  auto* to = const_cast<%s*>(static_cast<const %s*>(node));\n",
+          name, name);
+  fprintf(cc_, "  switch (to->tag()) {\n");
+  for (const auto& ctor : datatype.ctors) {
+    std::vector<Type> decomposed_type;
+    if (!DecomposeCtorType(ctor, &decomposed_type)) {
+      return false;
+    }
+    fprintf(cc_, "    case Tag::k%s: {\n", ctor.ident.c_str());
+    bool declared = false;
+    for (size_t i = 0; i < decomposed_type.size(); ++i) {
+      if (!IsReferenceType(decomposed_type[i])) {
+        continue;
+      }
+      if (!declared) {
+        fprintf(cc_, "      auto* n = static_cast<Unboxed%s*>(to);\n",
+                ctor.ident.c_str());
+        declared = true;
+      }
+      fprintf(cc_, "      n->m_%lu_ = copier->Evacuate(n->m_%lu_);\n", i, i);
+    }
+    fprintf(cc_, "    } break;\n");
+  }
+  fprintf(cc_, "  }\n}\n");
+  return true;
+}
+
+bool TtGenerator::IsReferenceType(const Type& type) {
+  return type != "const ::anodyne::Symbol" && type != "::anodyne::Unit" &&
+         type != "::anodyne::Range";
+}
+
 bool TtGenerator::DecomposeCtorType(const TtConstructor& constructor,
                                     std::vector<Type>* type_out) {
   if (constructor.type == nullptr) {
@@ -397,6 +505,10 @@ bool TtGenerator::DecomposeType(const TtTypeNode& type,
 bool TtGenerator::DecomposeIdentType(const TtTypeNode& type,
                                      std::vector<Type>* type_out) {
   Type append_out;
+  const char* slice = relocatable_ ? "::anodyne::RelocatableArenaSlice<"
+                                   : "::anodyne::ArenaSlice<";
+  const char* option = relocatable_ ? "::anodyne::RelocatableArenaOption<"
+                                    : "::anodyne::ArenaOption<";
   auto dt = parser_.datatypes().find(type.ident);
   if (dt != parser_.datatypes().end()) {
     if (type.is_array) {
@@ -404,9 +516,11 @@ bool TtGenerator::DecomposeIdentType(const TtTypeNode& type,
         Error(type.loc, "array and option are not miscible");
         return false;
       }
-      append_out = "::anodyne::ArenaSlice<" + dt->second.qualified_ident + ">";
+      append_out = slice + dt->second.qualified_ident + ">";
     } else if (type.is_option) {
-      append_out = "::anodyne::ArenaOption<" + dt->second.qualified_ident + ">";
+      append_out = option + dt->second.qualified_ident + ">";
+    } else if (relocatable_) {
+      append_out = "::anodyne::ArenaRef<" + dt->second.qualified_ident + ">";
     } else {
       append_out = "const " + dt->second.qualified_ident + "*";
     }
@@ -415,9 +529,9 @@ bool TtGenerator::DecomposeIdentType(const TtTypeNode& type,
   }
   if (type.ident == "ident") {
     if (type.is_array) {
-      append_out = "::anodyne::ArenaSlice<::anodyne::Symbol>";
+      append_out = std::string(slice) + "::anodyne::Symbol>";
     } else if (type.is_option) {
-      append_out = "::anodyne::ArenaOption<::anodyne::Symbol>";
+      append_out = std::string(option) + "::anodyne::Symbol>";
     } else {
       append_out = "const ::anodyne::Symbol";
     }
@@ -33,10 +33,13 @@ class TtGenerator {
   /// \param h_relative_path the path `cc` should use to refer to `h`.
   /// \param h an open file handle for writing header code.
   /// \param cc an open file handle for writing implementation code.
+  /// \param relocatable whether to link trees with `ArenaRef`s instead of
+  /// pointers, so that they can be stored in an `ArenaSnapshot`.
   static bool GenerateCode(const TtParser& parser, const Source& source,
                            absl::string_view h_relative_path, FILE* h,
-                           FILE* cc) {
-    return TtGenerator(parser, source, h_relative_path, h, cc).Generate();
+                           FILE* cc, bool relocatable = false) {
+    return TtGenerator(parser, source, h_relative_path, h, cc, relocatable)
+        .Generate();
   }
   /// \brief Generate code for the matchers in `parser`.
   /// \param parser the parser containing matchers.
@@ -44,18 +47,21 @@ class TtGenerator {
   /// \param m an open file handle for writing matcher code.
   static bool GenerateMatchers(const TtParser& parser, const Source& source,
                                FILE* m) {
-    return TtGenerator(parser, source, "", m, nullptr).GenerateMatchers();
+    return TtGenerator(parser, source, "", m, nullptr, false)
+        .GenerateMatchers();
   }
 
  private:
   using Type = std::string;
   TtGenerator(const TtParser& parser, const Source& source,
-              absl::string_view h_relative_path, FILE* h, FILE* cc)
+              absl::string_view h_relative_path, FILE* h, FILE* cc,
+              bool relocatable)
       : parser_(parser),
         source_(source),
         h_relative_path_(h_relative_path),
         h_(h),
-        cc_(cc) {}
+        cc_(cc),
+        relocatable_(relocatable) {}
   /// \brief Generate the header and source preamble for datatype definitions.
   /// \return false on failure.
   bool GeneratePreamble();
@@ -72,6 +78,12 @@ class TtGenerator {
   /// \return false on failure.
   bool GenerateCtorRep(const TtDatatype& datatype,
                        const TtConstructor& constructor);
+  /// \brief Generate the functions that copy `datatype` between arenas.
+  /// \return false on failure.
+  bool GenerateCopier(const TtDatatype& datatype);
+  /// \return whether fields of type `type` refer to arena memory (and so
+  /// must be updated when their node is copied).
+  static bool IsReferenceType(const Type& type);
   /// \brief Generate the implementation code for matchers.
   /// \return false on failure.
   bool GenerateMatchers();
@@ -111,6 +123,8 @@ class TtGenerator {
   FILE* h_;
   /// An open file handle to the implementation file.
   FILE* cc_;
+  /// Whether to generate relocatable datatypes.
+  bool relocatable_;
 };
 }  // namespace anodyne
 